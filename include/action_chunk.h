@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "rotation.h"
+
+
+// 一个动作块：从 start 开始每隔 period 执行一个动作，共 steps 个
+// 位置部分为 N 维向量（关节角度或 tcp 位置），with_orientation 时 q 为对应的 tcp 姿态
+template <std::size_t N>
+struct ActionChunk {
+    static constexpr std::size_t kMaxSteps = 100;
+
+    double start = 0.0;   // 第一个动作的执行时刻（steady_clock 秒，与发布的 Timestamp 相同）
+    double period = 0.0;  // 相邻动作的间隔 (秒)
+    uint32_t steps = 0;
+    std::array<std::array<double, N>, kMaxSteps> p;
+    std::array<Quaternion, kMaxSteps> q;
+};
+
+struct EnsembleConfig {
+    // 指数时间集成的系数 k (1/秒)，每个动作块的权重为 exp(-k * (t - start))
+    // k > 0 偏向较新的动作块，响应快；k < 0 偏向较早的动作块，更平滑（ACT 的做法）；k = 0 等权平均
+    double rate = -0.5;
+    // 动作块开始后与结束前的这段时间 (秒) 内，权重从 0 线性增加或线性减为 0，不足的部分由上一次的输出补上，
+    // 避免动作块加入或结束时输出跳变
+    double fade = 0.02;
+};
+
+// 以下计数除 received、evicted 外均为调用 sample() 的周期数
+struct EnsembleStats {
+    uint64_t received = 0;   // 收到的动作块
+    uint64_t evicted = 0;    // 动作块已满时被挤掉的最早的动作块
+    uint64_t blended = 0;    // 有多个动作块重叠，加权平均
+    uint64_t single = 0;     // 只有一个动作块覆盖当前时刻
+    uint64_t held = 0;       // 没有动作块覆盖当前时刻，保持上一次的输出
+    uint32_t max_overlap = 0;
+};
+
+// 动作块执行器：保存重叠的多个动作块，每周期对覆盖当前时刻的动作块做指数加权平均
+// 块内相邻动作之间线性插值（姿态用 SLERP），只由实时回调访问，不分配内存
+template <std::size_t N>
+class ActionChunkExecutor {
+public:
+    using Vector = std::array<double, N>;
+    static constexpr std::size_t kMaxChunks = 8;
+
+    ActionChunkExecutor(const EnsembleConfig& config, bool with_orientation)
+        : config_(config), with_orientation_(with_orientation) {}
+
+    // 清空动作块，保持在 (p, q)
+    void reset(const Vector& p, const Quaternion& q = Quaternion()) {
+        for (auto& slot : slots_) {
+            slot.used = false;
+        }
+        out_p_ = p;
+        out_q_ = q;
+    }
+
+    // 加入一个动作块，已满时替换开始时刻最早的一个
+    void push(const ActionChunk<N>& chunk) {
+        ++stats_.received;
+        if (chunk.steps == 0 || !(chunk.period > 0.0)) {
+            return;
+        }
+        Slot* target = nullptr;
+        for (auto& slot : slots_) {
+            if (!slot.used) {
+                target = &slot;
+                break;
+            }
+            if (!target || slot.chunk.start < target->chunk.start) {
+                target = &slot;
+            }
+        }
+        if (target->used) {
+            ++stats_.evicted;
+        }
+        target->used = true;
+        target->first_active = -1.0;
+        target->chunk.start = chunk.start;
+        target->chunk.period = chunk.period;
+        target->chunk.steps = chunk.steps;
+        std::copy(chunk.p.begin(), chunk.p.begin() + chunk.steps, target->chunk.p.begin());
+        if (with_orientation_) {
+            std::copy(chunk.q.begin(), chunk.q.begin() + chunk.steps, target->chunk.q.begin());
+        }
+    }
+
+    // 计算 t 时刻的目标，没有动作块覆盖时保持上一次的输出，返回是否有动作块覆盖
+    bool sample(double t, Vector& p, Quaternion& q) {
+        Vector sum_p = {};
+        std::array<double, 4> sum_q = {0.0, 0.0, 0.0, 0.0};
+        double sum_w = 0.0;
+        double sum_full = 0.0;  // 不计淡入淡出的总权重
+        uint32_t overlap = 0;
+        for (auto& slot : slots_) {
+            if (!slot.used) {
+                continue;
+            }
+            const ActionChunk<N>& c = slot.chunk;
+            double f = (t - c.start) / c.period;
+            if (f >= c.steps) {
+                // 已经执行完
+                slot.used = false;
+                continue;
+            }
+            if (f < 0.0) {
+                continue;
+            }
+            if (slot.first_active < 0.0) {
+                slot.first_active = t;
+            }
+            std::size_t i = static_cast<std::size_t>(f);
+            std::size_t j = i + 1 < c.steps ? i + 1 : i;
+            double h = f - i;
+
+            double w = std::exp(-config_.rate * (t - c.start));
+            sum_full += w;
+            if (config_.fade > 0.0) {
+                double remaining = (c.steps - f) * c.period;
+                w *= std::fmin(1.0, std::fmin(t - slot.first_active, remaining) / config_.fade);
+            }
+            for (std::size_t k = 0; k < N; ++k) {
+                sum_p[k] += w * (c.p[i][k] + h * (c.p[j][k] - c.p[i][k]));
+            }
+            if (with_orientation_) {
+                Quaternion qi = quaternionSlerp(c.q[i], c.q[j], h);
+                // 与上一次的输出取同一半球再相加
+                double sign = quaternionDot(qi, out_q_) < 0.0 ? -w : w;
+                sum_q[0] += sign * qi.w;
+                sum_q[1] += sign * qi.x;
+                sum_q[2] += sign * qi.y;
+                sum_q[3] += sign * qi.z;
+            }
+            sum_w += w;
+            ++overlap;
+        }
+
+        if (overlap == 0) {
+            ++stats_.held;
+        } else {
+            if (overlap > 1) {
+                ++stats_.blended;
+            } else {
+                ++stats_.single;
+            }
+            if (overlap > stats_.max_overlap) {
+                stats_.max_overlap = overlap;
+            }
+            // 淡入淡出中缺少的权重给上一次的输出
+            double hold_w = sum_full - sum_w;
+            for (std::size_t k = 0; k < N; ++k) {
+                sum_p[k] += hold_w * out_p_[k];
+            }
+            sum_q[0] += hold_w * out_q_.w;
+            sum_q[1] += hold_w * out_q_.x;
+            sum_q[2] += hold_w * out_q_.y;
+            sum_q[3] += hold_w * out_q_.z;
+            sum_w = sum_full;
+            for (std::size_t k = 0; k < N; ++k) {
+                out_p_[k] = sum_p[k] / sum_w;
+            }
+            if (with_orientation_) {
+                out_q_ = {sum_q[0], sum_q[1], sum_q[2], sum_q[3]};
+                quaternionNormalize(out_q_);
+            }
+        }
+        p = out_p_;
+        q = out_q_;
+        return overlap > 0;
+    }
+
+    // 不插值姿态时使用
+    bool sample(double t, Vector& p) {
+        Quaternion q;
+        return sample(t, p, q);
+    }
+
+    const EnsembleStats& stats() const { return stats_; }
+
+    static void print(const char* name, const EnsembleStats& s) {
+        std::cout << name << ": received=" << s.received << " evicted=" << s.evicted << " blended=" << s.blended
+                  << " single=" << s.single << " held=" << s.held << " max_overlap=" << s.max_overlap << std::endl;
+    }
+
+private:
+    struct Slot {
+        bool used = false;
+        double first_active = -1.0;  // 第一次覆盖当前时刻的时间，用于淡入
+        ActionChunk<N> chunk;
+    };
+
+    EnsembleConfig config_;
+    bool with_orientation_;
+    EnsembleStats stats_;
+    std::array<Slot, kMaxChunks> slots_;
+    Vector out_p_ = {};
+    Quaternion out_q_;
+};
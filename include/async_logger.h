@@ -0,0 +1,228 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "spsc_queue.h"
+
+
+enum class LogLevel : uint8_t {
+    info,   // 输出到 stdout
+    warn,   // 输出到 stderr
+    error,  // 输出到 stderr
+};
+
+// 二进制日志记录，只保存格式串指针和数值参数，由后台线程格式化
+// 格式串必须是字符串常量，参数一律按 double 传给 printf，整数请用 %.0f
+struct LogRecord {
+    int64_t stamp_ns;
+    const char* fmt;
+    LogLevel level;
+    uint8_t argc;
+    uint32_t suppressed;   // 在这条记录之前被限流丢掉的同一格式串记录数
+    double args[8];
+};
+
+// 异步日志：每个线程第一次写日志时领取一个 SPSC 环形队列，之后写日志只是一次入队
+// 写入端不加锁、不分配内存，除领取队列外不做系统调用，可以在实时回调中使用；队列满时丢弃并计数
+// 写入线程退出后它的队列可以被新的线程领取，SDK 每次 startLoop 都可能创建新的控制线程
+class AsyncLogger {
+public:
+    static constexpr std::size_t kMaxThreads = 8;
+    static constexpr std::size_t kRingSize = 1024;
+    static constexpr std::size_t kRateLimitSlots = 16;
+
+    AsyncLogger() : rings_(new Ring[kMaxThreads]) {}
+    ~AsyncLogger() { stop(); }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // 启动后台格式化线程
+    void start(std::chrono::milliseconds flush_interval = std::chrono::milliseconds(10)) {
+        if (running_.exchange(true)) {
+            return;
+        }
+        worker_ = std::thread([this, flush_interval]() {
+            while (running_.load(std::memory_order_relaxed)) {
+                drain();
+                std::this_thread::sleep_for(flush_interval);
+            }
+            drain();
+        });
+    }
+
+    // 停止后台线程并输出剩余的记录
+    void stop() {
+        if (running_.exchange(false) && worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    template <class... Args>
+    void log(LogLevel level, const char* fmt, Args... args) {
+        Ring* ring = threadRing();
+        if (!ring) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        push(*ring, level, 0, fmt, args...);
+    }
+
+    // 同一格式串在 interval 内只记录一次，其余的只计数，下一条记录会带上被丢掉的条数
+    template <class... Args>
+    void logRateLimited(std::chrono::steady_clock::duration interval, LogLevel level, const char* fmt, Args... args) {
+        Ring* ring = threadRing();
+        if (!ring) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        RateLimit* slot = nullptr;
+        for (auto& limit : ring->limits) {
+            if (limit.fmt == fmt || limit.fmt == nullptr) {
+                slot = &limit;
+                break;
+            }
+        }
+        if (!slot) {
+            // 表满时不限流
+            push(*ring, level, 0, fmt, args...);
+            return;
+        }
+        if (slot->fmt == fmt && now - slot->last < interval) {
+            ++slot->suppressed;
+            rate_limited_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uint32_t suppressed = slot->suppressed;
+        slot->fmt = fmt;
+        slot->last = now;
+        slot->suppressed = 0;
+        push(*ring, level, suppressed, fmt, args...);
+    }
+
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t rateLimited() const { return rate_limited_.load(std::memory_order_relaxed); }
+    uint64_t recycledRings() const { return recycled_.load(std::memory_order_relaxed); }
+
+    void printStats(const char* name) const {
+        std::printf("%s: written=%llu dropped=%llu rate_limited=%llu recycled_rings=%llu\n", name,
+                    static_cast<unsigned long long>(written()), static_cast<unsigned long long>(dropped()),
+                    static_cast<unsigned long long>(rateLimited()), static_cast<unsigned long long>(recycledRings()));
+    }
+
+private:
+    struct RateLimit {
+        const char* fmt = nullptr;
+        std::chrono::steady_clock::time_point last;
+        uint32_t suppressed = 0;
+    };
+
+    struct Ring {
+        SpscQueue<LogRecord, kRingSize> queue;
+        std::array<RateLimit, kRateLimitSlots> limits;  // 只由写入线程访问
+        std::atomic<pid_t> writer{0};                    // 写入线程的内核线程号，0 表示未被领取
+    };
+
+    Ring* threadRing() {
+        thread_local AsyncLogger* owner = nullptr;
+        thread_local Ring* ring = nullptr;
+        if (owner != this) {
+            ring = claimRing();
+            owner = this;
+        }
+        return ring;
+    }
+
+    // 先找未被领取的队列，没有时回收写入线程已经退出的队列，它留下的记录照常输出
+    // 只在线程第一次写日志时调用，全部队列都被存活的线程占用时返回 nullptr，该线程的日志计入 dropped
+    Ring* claimRing() {
+        pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+        for (std::size_t i = 0; i < kMaxThreads; ++i) {
+            pid_t expected = 0;
+            if (rings_[i].writer.compare_exchange_strong(expected, self, std::memory_order_acq_rel)) {
+                return &rings_[i];
+            }
+        }
+        pid_t pid = getpid();
+        for (std::size_t i = 0; i < kMaxThreads; ++i) {
+            pid_t writer = rings_[i].writer.load(std::memory_order_acquire);
+            if (syscall(SYS_tgkill, pid, writer, 0) != 0 && errno == ESRCH &&
+                rings_[i].writer.compare_exchange_strong(writer, self, std::memory_order_acq_rel)) {
+                rings_[i].limits.fill(RateLimit{});
+                recycled_.fetch_add(1, std::memory_order_relaxed);
+                return &rings_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    template <class... Args>
+    void push(Ring& ring, LogLevel level, uint32_t suppressed, const char* fmt, Args... args) {
+        static_assert(sizeof...(Args) <= 8, "日志最多 8 个参数");
+        LogRecord record;
+        record.stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        record.fmt = fmt;
+        record.level = level;
+        record.argc = sizeof...(Args);
+        record.suppressed = suppressed;
+        std::size_t i = 0;
+        ((record.args[i++] = static_cast<double>(args)), ...);
+        if (ring.queue.push(record)) {
+            written_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void drain() {
+        LogRecord record;
+        for (std::size_t i = 0; i < kMaxThreads; ++i) {
+            while (rings_[i].queue.pop(record)) {
+                format(record);
+            }
+        }
+        std::fflush(stdout);
+    }
+
+    static void format(const LogRecord& r) {
+        char text[512];
+        const double* a = r.args;
+        switch (r.argc) {
+            case 0: std::snprintf(text, sizeof(text), "%s", r.fmt); break;
+            case 1: std::snprintf(text, sizeof(text), r.fmt, a[0]); break;
+            case 2: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1]); break;
+            case 3: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2]); break;
+            case 4: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2], a[3]); break;
+            case 5: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2], a[3], a[4]); break;
+            case 6: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2], a[3], a[4], a[5]); break;
+            case 7: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6]); break;
+            default: std::snprintf(text, sizeof(text), r.fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]); break;
+        }
+        std::FILE* out = r.level == LogLevel::info ? stdout : stderr;
+        if (r.suppressed > 0) {
+            std::fprintf(out, "[%.3f] %s (此前另有 %u 条被限流)\n", r.stamp_ns * 1e-9, text, r.suppressed);
+        } else {
+            std::fprintf(out, "[%.3f] %s\n", r.stamp_ns * 1e-9, text);
+        }
+    }
+
+    std::unique_ptr<Ring[]> rings_;
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> rate_limited_{0};
+    std::atomic<uint64_t> recycled_{0};
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+};
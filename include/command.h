@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+enum class CmdType {
+    xyzrpy_vel, // 接收笛卡尔速度
+    joint_pose, // 接收关节角度（不插值时期望接收频率接近1000Hz，否则会运动不平滑）
+    pose_mat,   // 接收tcp变换矩阵（不插值时期望接收频率接近1000Hz，否则会运动不平滑）
+    joint_chunk, // 接收一段未来的关节角度序列（动作块），重叠的动作块做时间集成
+    joint_vel,   // 接收归一化的关节速度
+    pose_chunk,  // 接收一段未来的tcp变换矩阵序列（动作块），重叠的动作块做时间集成
+    xyzrpy_vel_ik, // 接收笛卡尔速度（与xyzrpy_vel相同的消息），在轴空间用阻尼最小二乘求关节速度
+};
+
+// 在轴空间控制，否则在笛卡尔空间控制
+inline bool isJointCommand(CmdType type) {
+    return type == CmdType::joint_pose || type == CmdType::joint_chunk || type == CmdType::joint_vel ||
+           type == CmdType::xyzrpy_vel_ik;
+}
+
+// 速度命令，超时后需要停下
+constexpr bool isVelocityCommand(CmdType type) {
+    return type == CmdType::xyzrpy_vel || type == CmdType::joint_vel || type == CmdType::xyzrpy_vel_ik;
+}
+
+// 控制模式期望收到的消息类型：xyzrpy_vel_ik 接收与 xyzrpy_vel 相同的 cartesian_velocity 消息
+constexpr CmdType messageType(CmdType mode) {
+    return mode == CmdType::xyzrpy_vel_ik ? CmdType::xyzrpy_vel : mode;
+}
+
+// 实时回调在该控制模式下是否应用这条消息类型的命令
+constexpr bool acceptsCommand(CmdType mode, CmdType message) {
+    return messageType(mode) == message;
+}
+
+static_assert(acceptsCommand(CmdType::xyzrpy_vel_ik, CmdType::xyzrpy_vel),
+              "xyzrpy_vel_ik 模式必须应用 cartesian_velocity 消息");
+static_assert(isVelocityCommand(messageType(CmdType::xyzrpy_vel_ik)), "xyzrpy_vel_ik 的命令超时后需要停下");
+
+// 命令类型的名称，与 zmq 消息中 "mode" 字段的取值相同
+inline const char* cmdTypeName(CmdType type) {
+    switch (type) {
+        case CmdType::xyzrpy_vel: return "xyzrpy_vel";
+        case CmdType::joint_pose: return "joint_pose";
+        case CmdType::pose_mat: return "pose_mat";
+        case CmdType::joint_chunk: return "joint_chunk";
+        case CmdType::pose_chunk: return "pose_chunk";
+        case CmdType::joint_vel: return "joint_vel";
+        case CmdType::xyzrpy_vel_ik: return "xyzrpy_vel_ik";
+    }
+    return "unknown";
+}
+
+inline bool parseCmdType(const std::string& name, CmdType& type) {
+    for (CmdType t : {CmdType::xyzrpy_vel, CmdType::joint_pose, CmdType::pose_mat,
+                      CmdType::joint_chunk, CmdType::pose_chunk, CmdType::joint_vel, CmdType::xyzrpy_vel_ik}) {
+        if (name == cmdTypeName(t)) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 控制模式，运行中可以切换
+struct ControlMode {
+    CmdType cmd_type = CmdType::xyzrpy_vel;
+    bool position_control = true;  // 位置控制，否则为阻抗控制
+    bool desired_pose = true;      // （仅在xyzrpy_vel与xyzrpy_vel_ik时有效）从期望位置积分，否则从实时查询到的位置
+    bool tcp_move = true;          // （仅在xyzrpy_vel与xyzrpy_vel_ik时有效）速度相对于工具坐标系，否则相对于基坐标系
+};
+
+// zmq_receiver 交给实时回调的一条完整命令记录
+// 每种命令只更新对应的字段，其余字段保持上一次收到的值
+struct Command {
+    CmdType type = CmdType::xyzrpy_vel;               // 最近一条消息的类型
+    std::array<double, 6> cartesian_velocity = {0.0};
+    std::array<double, 16> pose_matrix = {0.0};
+    std::array<double, 7> joint_position = {0.0};
+    std::array<double, 7> joint_velocity = {0.0};
+    std::chrono::steady_clock::time_point recv_time;  // 最近一条消息的接收时间
+    std::chrono::steady_clock::time_point due_time;   // 最近一条消息的计划执行时间
+    std::chrono::steady_clock::time_point sent_time;  // 最近一条消息的发送时间换算到本地时钟，不带 sent_time 时为接收时间
+    uint64_t seq = 0;                                 // 收到的消息序号
+};
+
+// steady_clock 时间点与秒之间的转换，发布的 Timestamp 与插值、动作块的时间轴都使用这个时钟
+inline double steadySeconds(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(t.time_since_epoch()).count();
+}
+
+inline std::chrono::steady_clock::time_point steadyTimePoint(double seconds) {
+    return std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)));
+}
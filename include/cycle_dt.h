@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+
+// 积分步长的来源
+enum class IntegratorDt {
+    fixed,     // 固定为名义周期
+    measured,  // 由相邻两个控制周期的状态时间戳计算
+};
+
+// 由控制周期时间戳计算积分步长
+// 测得的间隔按名义周期取整为周期数：抖动不会改变步长，丢失的周期会被计入
+// 周期数限制在 [1, max_cycles]，超出的视为异常值（例如控制器暂停后恢复）并计数
+class CycleDt {
+public:
+    explicit CycleDt(double period = 0.001, int max_cycles = 5) : period_(period), max_cycles_(max_cycles) {}
+
+    double period() const { return period_; }
+
+    // 控制循环暂停后重新开始，下一次 update() 返回名义周期
+    void restart() { started_ = false; }
+
+    double update(std::chrono::steady_clock::time_point stamp) {
+        if (!started_) {
+            started_ = true;
+            last_ = stamp;
+            return period_;
+        }
+        double elapsed = std::chrono::duration<double>(stamp - last_).count();
+        last_ = stamp;
+        long cycles = std::lround(elapsed / period_);
+        if (cycles < 1) {
+            cycles = 1;
+        } else if (cycles > max_cycles_) {
+            cycles = max_cycles_;
+            ++clamped_;
+        }
+        missed_ += static_cast<uint64_t>(cycles - 1);
+        return cycles * period_;
+    }
+
+    uint64_t missed() const { return missed_; }
+    uint64_t clamped() const { return clamped_; }
+
+private:
+    double period_;
+    long max_cycles_;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point last_;
+    uint64_t missed_ = 0;   // 计入步长的丢失周期数
+    uint64_t clamped_ = 0;  // 被限制的异常间隔次数
+};
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "kinematics.h"
+#include "rotation.h"
+
+
+struct IkConfig {
+    std::size_t seeds = 32;            // 每个目标最多尝试的初值个数，第一个为调用者给出的初值
+    std::size_t max_iterations = 60;   // 每个初值的最大迭代次数
+    double position_tolerance = 1e-4;  // 米
+    double rotation_tolerance = 1e-3;  // 弧度
+    double max_step = 0.3;             // 每次迭代各关节的最大步长（弧度）
+    DlsConfig damping = {0.05, 0.02};
+};
+
+struct IkResult {
+    bool reachable = false;
+    std::array<double, 7> q = {0.0};  // 可达时为逆解，否则为误差最小的关节角度
+    double position_error = 0.0;
+    double rotation_error = 0.0;
+    uint32_t seeds_tried = 0;
+};
+
+// 法兰位姿误差 [目标位置 - 当前位置; R_target R_current^T 的旋转向量]，均在基坐标系中
+inline void poseError(const std::array<double, 16>& target, const std::array<double, 16>& current, std::array<double, 6>& e) {
+    e[0] = target[3] - current[3];
+    e[1] = target[7] - current[7];
+    e[2] = target[11] - current[11];
+    std::array<double, 16> R = {0.0};
+    for (std::size_t i = 0; i < 3; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) {
+            R[i * 4 + j] = target[i * 4] * current[j * 4] + target[i * 4 + 1] * current[j * 4 + 1] +
+                           target[i * 4 + 2] * current[j * 4 + 2];
+        }
+    }
+    R[15] = 1.0;
+    std::array<double, 3> r = quaternionToRotationVector(quaternionFromMatrix(R));
+    e[3] = r[0];
+    e[4] = r[1];
+    e[5] = r[2];
+}
+
+// 从一个初值迭代 q += clamp(J^T (J J^T + λ² I)^{-1} e)，关节限制在限位内，不分配内存
+// result 中保存误差最小的一次，收敛时返回 true
+template <class Model = XMateEr7Pro>
+bool solveIkFromSeed(const std::array<double, 16>& target, const std::array<double, Model::kDof>& seed,
+                     const IkConfig& config, IkResult& result) {
+    constexpr std::size_t n = Model::kDof;
+    std::array<double, n> q = seed;
+    std::array<double, 6 * n> J;
+    std::array<double, 16> flange;
+    const std::array<double, n> zero = {0.0};
+    double best = -1.0;
+    for (std::size_t it = 0; it <= config.max_iterations; ++it) {
+        jacobian<Model>(q, J, flange);
+        std::array<double, 6> e;
+        poseError(target, flange, e);
+        double position = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+        double rotation = std::sqrt(e[3] * e[3] + e[4] * e[4] + e[5] * e[5]);
+        // 位置误差 1mm 与旋转误差 0.01rad 同等看待
+        double cost = position / config.position_tolerance + rotation / config.rotation_tolerance;
+        if (best < 0.0 || cost < best) {
+            best = cost;
+            result.q = q;
+            result.position_error = position;
+            result.rotation_error = rotation;
+        }
+        if (position <= config.position_tolerance && rotation <= config.rotation_tolerance) {
+            return true;
+        }
+        if (it == config.max_iterations) {
+            break;
+        }
+        std::array<double, n> dq;
+        dampedLeastSquares<n>(J, e, zero, config.damping, dq);
+        for (std::size_t i = 0; i < n; ++i) {
+            double step = std::fmax(-config.max_step, std::fmin(config.max_step, dq[i]));
+            q[i] = std::fmax(Model::kJointLower[i], std::fmin(Model::kJointUpper[i], q[i] + step));
+        }
+    }
+    return false;
+}
+
+// 第 k 个初值（k >= 1），用 Halton 序列在关节限位内均匀铺开，结果确定
+template <class Model = XMateEr7Pro>
+std::array<double, Model::kDof> ikSeed(std::size_t k) {
+    static constexpr std::array<uint32_t, 7> primes = {2, 3, 5, 7, 11, 13, 17};
+    std::array<double, Model::kDof> q;
+    for (std::size_t i = 0; i < Model::kDof; ++i) {
+        double f = 1.0;
+        double h = 0.0;
+        for (std::size_t x = k; x > 0; x /= primes[i]) {
+            f /= primes[i];
+            h += f * (x % primes[i]);
+        }
+        q[i] = Model::kJointLower[i] + h * (Model::kJointUpper[i] - Model::kJointLower[i]);
+    }
+    return q;
+}
+
+// 常驻工作线程，parallelFor 把 [0, count) 分给工作线程与调用线程，全部完成后返回
+// 同一时刻只能有一个线程调用 parallelFor
+class WorkerPool {
+public:
+    explicit WorkerPool(std::size_t threads) {
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    std::size_t threads() const { return workers_.size(); }
+
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+        if (workers_.empty() || count <= 1) {
+            for (std::size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fn_ = &fn;
+            count_ = count;
+            next_ = 0;
+            active_ = workers_.size();
+            ++generation_;
+        }
+        start_cv_.notify_all();
+        run(fn, count);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]() { return active_ == 0; });
+        fn_ = nullptr;
+    }
+
+private:
+    void run(const std::function<void(std::size_t)>& fn, std::size_t count) {
+        for (std::size_t i = next_.fetch_add(1); i < count; i = next_.fetch_add(1)) {
+            fn(i);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(std::size_t)>* fn;
+            std::size_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+                fn = fn_;
+                count = count_;
+            }
+            run(*fn, count);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--active_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(std::size_t)>* fn_ = nullptr;
+    std::size_t count_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::size_t active_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+// 检查法兰目标位姿是否有逆解：先从给定初值（通常为上一个目标的解）迭代，失败后在多个核上并行尝试其余初值
+// 一批目标（动作块）时按目标并行，每个目标在自己的线程上依次尝试初值
+// 只由一个线程调用（zmq_receiver），不在实时线程上运行
+template <class Model = XMateEr7Pro>
+class ReachabilityChecker {
+public:
+    using Joints = std::array<double, Model::kDof>;
+
+    ReachabilityChecker(const IkConfig& config, std::size_t threads)
+        : config_(config), pool_(threads), seed_results_(config.seeds) {
+        for (std::size_t k = 1; k < config_.seeds; ++k) {
+            seeds_.push_back(ikSeed<Model>(k));
+        }
+    }
+
+    // 检查一个目标
+    void check(const std::array<double, 16>& target, const Joints& seed, IkResult& result) {
+        result.seeds_tried = 1;
+        if (solveIkFromSeed<Model>(target, seed, config_, result)) {
+            result.reachable = true;
+            return;
+        }
+        // 并行尝试其余初值，有一个收敛后其余的不再开始
+        std::atomic<bool> found{false};
+        std::atomic<uint32_t> tried{1};
+        pool_.parallelFor(seeds_.size(), [&](std::size_t k) {
+            IkResult& r = seed_results_[k];
+            r.reachable = false;
+            if (found.load(std::memory_order_relaxed)) {
+                r.seeds_tried = 0;
+                return;
+            }
+            tried.fetch_add(1, std::memory_order_relaxed);
+            r.seeds_tried = 1;
+            if (solveIkFromSeed<Model>(target, seeds_[k], config_, r)) {
+                r.reachable = true;
+                found.store(true, std::memory_order_relaxed);
+            }
+        });
+        // 取收敛的初值中序号最小的，都不收敛时取误差最小的
+        for (std::size_t k = 0; k < seeds_.size(); ++k) {
+            const IkResult& r = seed_results_[k];
+            if (r.seeds_tried == 0) {
+                continue;
+            }
+            if (r.reachable) {
+                result = r;
+                break;
+            }
+            if (cost(r) < cost(result)) {
+                result = r;
+            }
+        }
+        result.seeds_tried = tried.load(std::memory_order_relaxed);
+    }
+
+    // 检查一批目标，results 至少有 count 个元素
+    void check(const std::array<double, 16>* targets, std::size_t count, const Joints& seed, IkResult* results) {
+        if (count == 1) {
+            check(targets[0], seed, results[0]);
+            return;
+        }
+        pool_.parallelFor(count, [&](std::size_t i) {
+            IkResult& result = results[i];
+            result.seeds_tried = 1;
+            result.reachable = solveIkFromSeed<Model>(targets[i], seed, config_, result);
+            for (std::size_t k = 0; k < seeds_.size() && !result.reachable; ++k) {
+                IkResult r;
+                ++result.seeds_tried;
+                if (solveIkFromSeed<Model>(targets[i], seeds_[k], config_, r) || cost(r) < cost(result)) {
+                    uint32_t tried = result.seeds_tried;
+                    bool reachable = r.position_error <= config_.position_tolerance &&
+                                     r.rotation_error <= config_.rotation_tolerance;
+                    result = r;
+                    result.seeds_tried = tried;
+                    result.reachable = reachable;
+                }
+            }
+        });
+    }
+
+    std::size_t threads() const { return pool_.threads() + 1; }
+
+private:
+    double cost(const IkResult& r) const {
+        return r.position_error / config_.position_tolerance + r.rotation_error / config_.rotation_tolerance;
+    }
+
+    IkConfig config_;
+    WorkerPool pool_;
+    std::vector<Joints> seeds_;
+    std::vector<IkResult> seed_results_;
+};
+
+// 在后台线程上用 ReachabilityChecker 做多初值搜索，调用者只提交目标、之后取回结果，从不等待搜索
+// 同一时刻只搜索一个目标，上一个结果取回之前提交的目标被忽略；submit 与 poll 只由同一个线程调用
+template <class Model = XMateEr7Pro>
+class AsyncIkSearch {
+public:
+    using Joints = std::array<double, Model::kDof>;
+
+    AsyncIkSearch(const IkConfig& config, std::size_t threads) : checker_(config, threads) {
+        thread_ = std::thread([this]() { searchLoop(); });
+    }
+
+    ~AsyncIkSearch() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    AsyncIkSearch(const AsyncIkSearch&) = delete;
+    AsyncIkSearch& operator=(const AsyncIkSearch&) = delete;
+
+    // 提交一个法兰目标，正在搜索或结果未取回时返回 false
+    bool submit(const std::array<double, 16>& target, const Joints& seed) {
+        if (busy_) {
+            return false;
+        }
+        busy_ = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            target_ = target;
+            seed_ = seed;
+            pending_ = true;
+        }
+        cv_.notify_one();
+        return true;
+    }
+
+    // 取回已完成的搜索结果，没有时返回 false
+    bool poll(IkResult& result) {
+        if (!done_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        result = result_;
+        done_.store(false, std::memory_order_relaxed);
+        busy_ = false;
+        return true;
+    }
+
+private:
+    void searchLoop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]() { return stop_ || pending_; });
+                if (stop_) {
+                    return;
+                }
+                pending_ = false;
+            }
+            checker_.check(target_, seed_, result_);
+            done_.store(true, std::memory_order_release);
+        }
+    }
+
+    ReachabilityChecker<Model> checker_;
+    std::array<double, 16> target_ = {0.0};
+    Joints seed_ = {0.0};
+    IkResult result_;
+    bool busy_ = false;  // 只由调用者访问
+    std::atomic<bool> done_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool pending_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+};
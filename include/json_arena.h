@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json.hpp"
+
+
+// 单线程的 bump 分配器：预先申请一整块内存，分配只移动指针，释放不做事，reset 后整块复用
+// 用完时另外从堆上申请溢出块并计数，reset 时一并归还
+class JsonArena {
+public:
+    explicit JsonArena(std::size_t bytes) : buffer_(new unsigned char[bytes]), capacity_(bytes) {}
+
+    ~JsonArena() { releaseOverflow(); }
+
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t alignment) {
+        std::size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes > capacity_) {
+            ++overflows_;
+            void* block = ::operator new(bytes);
+            overflow_blocks_.push_back(block);
+            return block;
+        }
+        used_ = offset + bytes;
+        if (used_ > peak_) {
+            peak_ = used_;
+        }
+        return buffer_.get() + offset;
+    }
+
+    // 在 arena 上构造对象，对象不需要也不应该析构，内存在 reset 时回收
+    // basic_json 析构非空的数组与对象时会用 std::allocator 申请临时的栈，不析构可以避免这次分配
+    template <class T, class... Args>
+    T& make(Args&&... args) {
+        return *new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 之前分配的内存全部失效
+    void reset() {
+        used_ = 0;
+        releaseOverflow();
+    }
+
+    // ptr 是否由这个 arena 分配（在预先申请的整块内存中或是一个溢出块）
+    bool owns(const void* ptr) const {
+        const unsigned char* p = static_cast<const unsigned char*>(ptr);
+        if (p >= buffer_.get() && p < buffer_.get() + capacity_) {
+            return true;
+        }
+        for (const void* block : overflow_blocks_) {
+            if (block == ptr) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::size_t capacity() const { return capacity_; }
+    std::size_t peak() const { return peak_; }
+    uint64_t overflows() const { return overflows_; }
+
+private:
+    void releaseOverflow() {
+        for (void* block : overflow_blocks_) {
+            ::operator delete(block);
+        }
+        overflow_blocks_.clear();
+    }
+
+    std::unique_ptr<unsigned char[]> buffer_;
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+    std::size_t peak_ = 0;
+    uint64_t overflows_ = 0;
+    std::vector<void*> overflow_blocks_;
+    JsonArena* outer_ = nullptr;  // 嵌套的 JsonArenaScope 中外层的 arena
+
+    friend class JsonArenaScope;
+    template <class T>
+    friend struct ArenaAllocator;
+};
+
+// 当前线程正在使用的 JsonArena，为空时 ArenaAllocator 直接使用堆
+inline thread_local JsonArena* current_json_arena = nullptr;
+
+// 在作用域内让当前线程的 arena_json 从 arena 分配，离开时 reset
+// 作用域内创建的 arena_json 对象不能在离开后继续使用
+class JsonArenaScope {
+public:
+    explicit JsonArenaScope(JsonArena& arena) : arena_(arena), previous_(current_json_arena) {
+        arena_.outer_ = previous_;
+        current_json_arena = &arena_;
+    }
+
+    ~JsonArenaScope() {
+        current_json_arena = previous_;
+        arena_.outer_ = nullptr;
+        arena_.reset();
+    }
+
+    JsonArenaScope(const JsonArenaScope&) = delete;
+    JsonArenaScope& operator=(const JsonArenaScope&) = delete;
+
+private:
+    JsonArena& arena_;
+    JsonArena* previous_;
+};
+
+// basic_json 在需要时默认构造分配器，因此分配器不带状态，通过 current_json_arena 找到 arena
+template <class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() noexcept = default;
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        JsonArena* arena = current_json_arena;
+        if (!arena) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // 按指针判断归属：当前线程各层 arena 分配的内存在 reset 时统一回收，其余的（在作用域外分配的）归还给堆
+    void deallocate(T* ptr, std::size_t) noexcept {
+        for (const JsonArena* arena = current_json_arena; arena; arena = arena->outer_) {
+            if (arena->owns(ptr)) {
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// 节点、数组、字符串（包括对象的键）都从 arena 分配的 json
+using arena_json = nlohmann::basic_json<std::map, std::vector, ArenaString, bool, std::int64_t, std::uint64_t, double,
+                                        ArenaAllocator>;
+
+// 序列化到调用者复用的 out 中，out 的容量足够时不分配内存（json::dump 每次都新建字符串）
+template <class Json>
+void dumpJson(const Json& value, std::string& out) {
+    using Adapter = nlohmann::detail::output_string_adapter<char, std::string>;
+    out.clear();
+    nlohmann::detail::serializer<Json> serializer(std::allocate_shared<Adapter>(ArenaAllocator<Adapter>(), out), ' ');
+    serializer.dump(value, false, false, 0);
+}
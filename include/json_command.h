@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// 常见 JSON 命令的解码结果，由 JsonCommandScanner 直接写入，不分配内存
+struct JsonCommand {
+    enum Field : uint32_t {
+        kCartesianVelocity = 1,
+        kPoseMatrix = 2,
+        kJointPosition = 4,
+        kJointVelocity = 8,
+        kGripperVelocity = 16,
+        kSentTime = 32,
+        kExecTime = 64,
+    };
+
+    uint32_t fields = 0;  // 消息中出现的字段
+    std::array<double, 6> cartesian_velocity = {0.0};
+    std::array<double, 16> pose_matrix = {0.0};
+    std::array<double, 7> joint_position = {0.0};
+    std::array<double, 7> joint_velocity = {0.0};
+    double gripper_velocity = 0.0;
+    double sent_time = 0.0;
+    double exec_time = 0.0;
+
+    bool has(Field field) const { return fields & field; }
+};
+
+enum class JsonScanStatus {
+    ok,         // 只含已知的键，已写入 JsonCommand
+    fallback,   // 含有其它键（mode、动作块等），交给完整的 JSON 解析
+    malformed,  // 不是合法的命令，例如语法错误、数组长度不符
+};
+
+inline const char* jsonScanStatusName(JsonScanStatus status) {
+    switch (status) {
+        case JsonScanStatus::ok: return "ok";
+        case JsonScanStatus::fallback: return "fallback";
+        case JsonScanStatus::malformed: return "malformed";
+    }
+    return "unknown";
+}
+
+// 只认识一层对象 {"键": 数值或定长数值数组, ...} 的扫描器，直接在消息内存上解析，数值用 std::from_chars
+// 遇到不认识的键立即返回 fallback，不会读完整条消息；语法错误在第一个出错的字符处返回 malformed
+class JsonCommandScanner {
+public:
+    JsonScanStatus scan(const char* data, std::size_t size, JsonCommand& out) {
+        p_ = data;
+        end_ = data + size;
+        out.fields = 0;
+        skipSpace();
+        if (!consume('{')) {
+            return JsonScanStatus::malformed;
+        }
+        skipSpace();
+        if (consume('}')) {
+            return finish();
+        }
+        while (true) {
+            const char* key;
+            std::size_t length;
+            if (!readKey(key, length)) {
+                return JsonScanStatus::malformed;
+            }
+            if (length == 0) {
+                return JsonScanStatus::fallback;
+            }
+            skipSpace();
+            if (!consume(':')) {
+                return JsonScanStatus::malformed;
+            }
+            skipSpace();
+            JsonScanStatus status = readValue(key, length, out);
+            if (status != JsonScanStatus::ok) {
+                return status;
+            }
+            skipSpace();
+            if (consume('}')) {
+                return finish();
+            }
+            if (!consume(',')) {
+                return JsonScanStatus::malformed;
+            }
+            skipSpace();
+        }
+    }
+
+private:
+    JsonScanStatus readValue(const char* key, std::size_t length, JsonCommand& out) {
+        bool ok;
+        if (keyIs(key, length, "cartesian_velocity")) {
+            ok = readArray(out.cartesian_velocity);
+            out.fields |= JsonCommand::kCartesianVelocity;
+        } else if (keyIs(key, length, "pose_matrix")) {
+            ok = readArray(out.pose_matrix);
+            out.fields |= JsonCommand::kPoseMatrix;
+        } else if (keyIs(key, length, "joint_position")) {
+            ok = readArray(out.joint_position);
+            out.fields |= JsonCommand::kJointPosition;
+        } else if (keyIs(key, length, "joint_velocity")) {
+            ok = readArray(out.joint_velocity);
+            out.fields |= JsonCommand::kJointVelocity;
+        } else if (keyIs(key, length, "gripper_velocity")) {
+            ok = readNumber(out.gripper_velocity);
+            out.fields |= JsonCommand::kGripperVelocity;
+        } else if (keyIs(key, length, "sent_time")) {
+            ok = readNumber(out.sent_time);
+            out.fields |= JsonCommand::kSentTime;
+        } else if (keyIs(key, length, "exec_time")) {
+            ok = readNumber(out.exec_time);
+            out.fields |= JsonCommand::kExecTime;
+        } else {
+            return JsonScanStatus::fallback;
+        }
+        return ok ? JsonScanStatus::ok : JsonScanStatus::malformed;
+    }
+
+    JsonScanStatus finish() {
+        skipSpace();
+        return p_ == end_ ? JsonScanStatus::ok : JsonScanStatus::malformed;
+    }
+
+    // 带转义的键不会是已知的键，与空键一样返回 length = 0，当作不认识的键交给完整解析
+    bool readKey(const char*& key, std::size_t& length) {
+        if (!consume('"')) {
+            return false;
+        }
+        key = p_;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ == '\\' || static_cast<unsigned char>(*p_) < 0x20) {
+                length = 0;
+                return true;
+            }
+            ++p_;
+        }
+        if (p_ == end_) {
+            return false;
+        }
+        length = static_cast<std::size_t>(p_ - key);
+        ++p_;
+        return true;
+    }
+
+    template <std::size_t N>
+    bool readArray(std::array<double, N>& values) {
+        if (!consume('[')) {
+            return false;
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            skipSpace();
+            if (!readNumber(values[i])) {
+                return false;
+            }
+            skipSpace();
+            if (!consume(i + 1 < N ? ',' : ']')) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // JSON 数值以 '-' 或数字开头，from_chars 另外接受的 inf、nan 在这里被拒绝
+    bool readNumber(double& value) {
+        const char* digit = (p_ < end_ && *p_ == '-') ? p_ + 1 : p_;
+        if (digit == end_ || *digit < '0' || *digit > '9') {
+            return false;
+        }
+        std::from_chars_result result = std::from_chars(p_, end_, value);
+        if (result.ec != std::errc() || result.ptr == p_) {
+            return false;
+        }
+        p_ = result.ptr;
+        return true;
+    }
+
+    static bool keyIs(const char* key, std::size_t length, const char* name) {
+        return std::strlen(name) == length && std::memcmp(key, name, length) == 0;
+    }
+
+    void skipSpace() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+            ++p_;
+        }
+    }
+
+    bool consume(char c) {
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    const char* p_ = nullptr;
+    const char* end_ = nullptr;
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+
+// 标准 DH 参数的一行：T_i = Rz(theta + offset) * Tz(d) * Tx(a) * Rx(alpha)
+// 直接保存 cos(alpha) 与 sin(alpha)，使 alpha 为 0、±90° 时可以在编译期去掉相应的乘法
+struct DhRow {
+    double a;
+    double d;
+    double cos_alpha;
+    double sin_alpha;
+    double offset;
+};
+
+// xMate ER7 Pro 的 DH 参数（米），相邻关节轴互相垂直，关节全为 0 时机械臂竖直向上
+// 末行 d 为第 7 轴到法兰面的距离，结果为法兰在基坐标系中的位姿，与 tcpPose_m / robot.posture(flangeInBase) 对应
+// 参数来自机型手册，启动时会与 SDK 的位姿比对（见 FkCheck）
+struct XMateEr7Pro {
+    static constexpr std::size_t kDof = 7;
+    static constexpr std::array<DhRow, kDof> kDh = {{
+        {0.0, 0.4040, 0.0, -1.0, 0.0},
+        {0.0, 0.0,    0.0,  1.0, 0.0},
+        {0.0, 0.4375, 0.0, -1.0, 0.0},
+        {0.0, 0.0,    0.0,  1.0, 0.0},
+        {0.0, 0.4125, 0.0, -1.0, 0.0},
+        {0.0, 0.0,    0.0,  1.0, 0.0},
+        {0.0, 0.2755, 1.0,  0.0, 0.0},
+    }};
+    // 关节软限位（弧度）
+    static constexpr std::array<double, kDof> kJointLower = {-2.967, -2.094, -2.967, -2.094, -2.967, -2.094, -6.283};
+    static constexpr std::array<double, kDof> kJointUpper = {2.967, 2.094, 2.967, 2.094, 2.967, 2.094, 6.283};
+};
+
+// 刚体变换只保存前三行，行主序 [r00 r01 r02 x; r10 r11 r12 y; r20 r21 r22 z]
+using RigidTransform = std::array<double, 12>;
+
+// T = T * DH(kDh[I])，只用到 T 的三个旋转列 c0, c1, c2：
+// c0' = cθ c0 + sθ c1
+// c1' = cα (-sθ c0 + cθ c1) + sα c2
+// c2' = sα (sθ c0 - cθ c1) + cα c2
+// p'  = p + a c0' + d c2
+template <class Model, std::size_t I>
+inline void dhStep(double c, double s, RigidTransform& T) {
+    constexpr DhRow row = Model::kDh[I];
+    for (std::size_t r = 0; r < 3; ++r) {
+        double* t = &T[r * 4];
+        double c0 = c * t[0] + s * t[1];
+        double u = c * t[1] - s * t[0];  // -sθ c0 + cθ c1
+        double c2 = t[2];
+        if constexpr (row.d != 0.0) {
+            t[3] += row.d * c2;
+        }
+        if constexpr (row.a != 0.0) {
+            t[3] += row.a * c0;
+        }
+        t[0] = c0;
+        if constexpr (row.cos_alpha == 0.0) {
+            // alpha = ±90°
+            t[1] = row.sin_alpha * c2;
+            t[2] = -row.sin_alpha * u;
+        } else if constexpr (row.sin_alpha == 0.0) {
+            // alpha = 0 或 180°
+            t[1] = row.cos_alpha * u;
+            t[2] = row.cos_alpha * c2;
+        } else {
+            t[1] = row.cos_alpha * u + row.sin_alpha * c2;
+            t[2] = row.cos_alpha * c2 - row.sin_alpha * u;
+        }
+    }
+}
+
+template <class Model, std::size_t... I>
+inline void forwardKinematicsUnrolled(const std::array<double, Model::kDof>& q, RigidTransform& T,
+                                      std::index_sequence<I...>) {
+    std::array<double, Model::kDof> c, s;
+    for (std::size_t i = 0; i < Model::kDof; ++i) {
+        double theta = q[i] + Model::kDh[i].offset;
+        c[i] = std::cos(theta);
+        s[i] = std::sin(theta);
+    }
+    T = {1, 0, 0, 0,
+         0, 1, 0, 0,
+         0, 0, 1, 0};
+    (dhStep<Model, I>(c[I], s[I], T), ...);
+}
+
+// 由关节角度计算法兰在基坐标系中的位姿（行主序 4×4，与 rokae::Utils::postureToTransArray 的结果相同）
+template <class Model = XMateEr7Pro>
+inline void forwardKinematics(const std::array<double, Model::kDof>& q, std::array<double, 16>& flange_in_base) {
+    RigidTransform T;
+    forwardKinematicsUnrolled<Model>(q, T, std::make_index_sequence<Model::kDof>());
+    std::copy(T.begin(), T.end(), flange_in_base.begin());
+    flange_in_base[12] = 0.0;
+    flange_in_base[13] = 0.0;
+    flange_in_base[14] = 0.0;
+    flange_in_base[15] = 1.0;
+}
+
+// 关节轴在基坐标系中的方向与位置：joint I 绕第 I-1 个 DH 坐标系的 z 轴转动
+template <std::size_t N>
+struct JointAxes {
+    std::array<std::array<double, 3>, N> axis;
+    std::array<std::array<double, 3>, N> origin;
+};
+
+template <class Model, std::size_t... I>
+inline void forwardKinematicsAxes(const std::array<double, Model::kDof>& q, RigidTransform& T,
+                                  JointAxes<Model::kDof>& axes, std::index_sequence<I...>) {
+    std::array<double, Model::kDof> c, s;
+    for (std::size_t i = 0; i < Model::kDof; ++i) {
+        double theta = q[i] + Model::kDh[i].offset;
+        c[i] = std::cos(theta);
+        s[i] = std::sin(theta);
+    }
+    T = {1, 0, 0, 0,
+         0, 1, 0, 0,
+         0, 0, 1, 0};
+    auto record = [&](std::size_t i) {
+        axes.axis[i] = {T[2], T[6], T[10]};
+        axes.origin[i] = {T[3], T[7], T[11]};
+    };
+    ((record(I), dhStep<Model, I>(c[I], s[I], T)), ...);
+}
+
+// 法兰处的几何雅可比矩阵（6×kDof 行主序，前三行为线速度，后三行为角速度，均在基坐标系中），同时给出法兰位姿
+// 第 i 列为 [z_i × (p - o_i); z_i]；换到 tcp 只是左乘行列式为 1 的矩阵，不影响可操作度
+template <class Model = XMateEr7Pro>
+inline void jacobian(const std::array<double, Model::kDof>& q, std::array<double, 6 * Model::kDof>& J,
+                     std::array<double, 16>& flange_in_base) {
+    constexpr std::size_t n = Model::kDof;
+    RigidTransform T;
+    JointAxes<n> axes;
+    forwardKinematicsAxes<Model>(q, T, axes, std::make_index_sequence<n>());
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto& z = axes.axis[i];
+        double rx = T[3] - axes.origin[i][0];
+        double ry = T[7] - axes.origin[i][1];
+        double rz = T[11] - axes.origin[i][2];
+        J[0 * n + i] = z[1] * rz - z[2] * ry;
+        J[1 * n + i] = z[2] * rx - z[0] * rz;
+        J[2 * n + i] = z[0] * ry - z[1] * rx;
+        J[3 * n + i] = z[0];
+        J[4 * n + i] = z[1];
+        J[5 * n + i] = z[2];
+    }
+    std::copy(T.begin(), T.end(), flange_in_base.begin());
+    flange_in_base[12] = 0.0;
+    flange_in_base[13] = 0.0;
+    flange_in_base[14] = 0.0;
+    flange_in_base[15] = 1.0;
+}
+
+// 对称正定矩阵的 Cholesky 分解 A = L L^T，L 写入 A 的下三角，不正定时返回 false
+template <std::size_t N>
+inline bool choleskyDecompose(std::array<double, N * N>& A) {
+    for (std::size_t j = 0; j < N; ++j) {
+        double d = A[j * N + j];
+        for (std::size_t k = 0; k < j; ++k) {
+            d -= A[j * N + k] * A[j * N + k];
+        }
+        if (!(d > 0.0)) {
+            return false;
+        }
+        d = std::sqrt(d);
+        A[j * N + j] = d;
+        for (std::size_t i = j + 1; i < N; ++i) {
+            double v = A[i * N + j];
+            for (std::size_t k = 0; k < j; ++k) {
+                v -= A[i * N + k] * A[j * N + k];
+            }
+            A[i * N + j] = v / d;
+        }
+    }
+    return true;
+}
+
+// 用 choleskyDecompose 得到的 L 求解 L L^T x = b，结果写回 b
+template <std::size_t N>
+inline void choleskySolve(const std::array<double, N * N>& L, std::array<double, N>& b) {
+    for (std::size_t i = 0; i < N; ++i) {
+        double v = b[i];
+        for (std::size_t k = 0; k < i; ++k) {
+            v -= L[i * N + k] * b[k];
+        }
+        b[i] = v / L[i * N + i];
+    }
+    for (std::size_t i = N; i-- > 0;) {
+        double v = b[i];
+        for (std::size_t k = i + 1; k < N; ++k) {
+            v -= L[k * N + i] * b[k];
+        }
+        b[i] = v / L[i * N + i];
+    }
+}
+
+// J J^T，J 为 6×M 行主序
+template <std::size_t M>
+inline void jacobianProduct(const std::array<double, 6 * M>& J, std::array<double, 36>& A) {
+    for (std::size_t i = 0; i < 6; ++i) {
+        for (std::size_t j = 0; j <= i; ++j) {
+            double v = 0.0;
+            for (std::size_t k = 0; k < M; ++k) {
+                v += J[i * M + k] * J[j * M + k];
+            }
+            A[i * 6 + j] = v;
+            A[j * 6 + i] = v;
+        }
+    }
+}
+
+// Yoshikawa 可操作度 sqrt(det(J J^T))，J 为 6×M 行主序；由 Cholesky 分解得到，即 L 对角元素之积
+template <std::size_t M>
+inline double manipulability(const std::array<double, 6 * M>& J) {
+    std::array<double, 36> A;
+    jacobianProduct<M>(J, A);
+    if (!choleskyDecompose<6>(A)) {
+        return 0.0;
+    }
+    double w = 1.0;
+    for (std::size_t i = 0; i < 6; ++i) {
+        w *= A[i * 6 + i];
+    }
+    return w;
+}
+
+// 阻尼最小二乘的阻尼：可操作度低于 threshold 时 λ² = max_damping² (1 - (w / threshold)²)，否则为 0，即伪逆
+struct DlsConfig {
+    double max_damping = 0.05;
+    double threshold = 0.02;
+};
+
+// 阻尼最小二乘微分逆运动学，A = J J^T + λ² I：
+// dq = J^T A^{-1} v + (I - J^T A^{-1} J) z = z + J^T A^{-1} (v - J z)
+// v 为末端速度 [线速度, 角速度]，z 为希望在零空间中执行的关节速度（λ 为 0 时投影后不影响末端速度）
+// 返回可操作度，J J^T + λ² I 不正定时（只在 λ 为 0 且恰好奇异时）dq 为 0
+template <std::size_t M>
+inline double dampedLeastSquares(const std::array<double, 6 * M>& J, const std::array<double, 6>& v,
+                                 const std::array<double, M>& z, const DlsConfig& config, std::array<double, M>& dq) {
+    std::array<double, 36> A;
+    jacobianProduct<M>(J, A);
+    std::array<double, 36> L = A;
+    double w = 0.0;
+    if (choleskyDecompose<6>(L)) {
+        w = 1.0;
+        for (std::size_t i = 0; i < 6; ++i) {
+            w *= L[i * 6 + i];
+        }
+    }
+    if (w < config.threshold) {
+        double r = w / config.threshold;
+        double damping2 = config.max_damping * config.max_damping * (1.0 - r * r);
+        for (std::size_t i = 0; i < 6; ++i) {
+            A[i * 6 + i] += damping2;
+        }
+        L = A;
+        if (!choleskyDecompose<6>(L)) {
+            dq = {};
+            return w;
+        }
+    }
+    std::array<double, 6> y;
+    for (std::size_t i = 0; i < 6; ++i) {
+        double jz = 0.0;
+        for (std::size_t k = 0; k < M; ++k) {
+            jz += J[i * M + k] * z[k];
+        }
+        y[i] = v[i] - jz;
+    }
+    choleskySolve<6>(L, y);
+    for (std::size_t k = 0; k < M; ++k) {
+        double v_k = z[k];
+        for (std::size_t i = 0; i < 6; ++i) {
+            v_k += J[i * M + k] * y[i];
+        }
+        dq[k] = v_k;
+    }
+    return w;
+}
+
+// 按可操作度缩放笛卡尔速度：高于 threshold 时为 1，在 [minimum, threshold] 内平滑（smoothstep）降到 min_scale
+// min_scale 大于 0，保留一点速度以便离开奇异位形
+struct SingularityScalingConfig {
+    double threshold = 0.02;
+    double minimum = 0.002;
+    double min_scale = 0.1;
+};
+
+inline double singularityScale(double w, const SingularityScalingConfig& config) {
+    if (w >= config.threshold) {
+        return 1.0;
+    }
+    double x = std::fmax(0.0, (w - config.minimum) / (config.threshold - config.minimum));
+    return config.min_scale + (1.0 - config.min_scale) * x * x * (3.0 - 2.0 * x);
+}
+
+// 两个齐次变换相乘 result = A * B，省去最后一行的计算，比 multiplyMatrices<4> 少约一半乘法
+inline void multiplyTransforms(const std::array<double, 16>& A, const std::array<double, 16>& B, std::array<double, 16>& result) {
+    for (std::size_t i = 0; i < 3; ++i) {
+        const double* a = &A[i * 4];
+        for (std::size_t j = 0; j < 4; ++j) {
+            result[i * 4 + j] = a[0] * B[j] + a[1] * B[4 + j] + a[2] * B[8 + j];
+        }
+        result[i * 4 + 3] += a[3];
+    }
+    result[12] = 0.0;
+    result[13] = 0.0;
+    result[14] = 0.0;
+    result[15] = 1.0;
+}
+
+// 刚体变换的逆 [R^T, -R^T p]
+inline void invertTransform(const std::array<double, 16>& T, std::array<double, 16>& inverse) {
+    for (std::size_t i = 0; i < 3; ++i) {
+        for (std::size_t j = 0; j < 3; ++j) {
+            inverse[i * 4 + j] = T[j * 4 + i];
+        }
+        inverse[i * 4 + 3] = -(T[i] * T[3] + T[4 + i] * T[7] + T[8 + i] * T[11]);
+    }
+    inverse[12] = 0.0;
+    inverse[13] = 0.0;
+    inverse[14] = 0.0;
+    inverse[15] = 1.0;
+}
+
+// 由关节角度计算 tcp 在基坐标系中的位姿 flange_in_base * tcp_frame
+template <class Model = XMateEr7Pro>
+inline void forwardKinematicsTcp(const std::array<double, Model::kDof>& q, const std::array<double, 16>& tcp_frame,
+                                 std::array<double, 16>& tcp_in_base) {
+    std::array<double, 16> flange_in_base;
+    forwardKinematics<Model>(q, flange_in_base);
+    multiplyTransforms(flange_in_base, tcp_frame, tcp_in_base);
+}
+
+// 正运动学与 SDK 位姿的比对：位置误差 (米) 与旋转误差 (弧度) 的最大值和均值
+// 只由一个线程更新，不分配内存
+class FkCheck {
+public:
+    void update(const std::array<double, 16>& fk, const std::array<double, 16>& sdk) {
+        double dx = fk[3] - sdk[3];
+        double dy = fk[7] - sdk[7];
+        double dz = fk[11] - sdk[11];
+        double position = std::sqrt(dx * dx + dy * dy + dz * dz);
+        // trace(R_fk^T R_sdk) = 1 + 2 cos(angle)
+        double trace = 0.0;
+        for (std::size_t i = 0; i < 3; ++i) {
+            for (std::size_t j = 0; j < 3; ++j) {
+                trace += fk[i * 4 + j] * sdk[i * 4 + j];
+            }
+        }
+        double rotation = std::acos(std::fmax(-1.0, std::fmin(1.0, 0.5 * (trace - 1.0))));
+        last_position_ = position;
+        last_rotation_ = rotation;
+        max_position_ = std::fmax(max_position_, position);
+        max_rotation_ = std::fmax(max_rotation_, rotation);
+        sum_position_ += position;
+        sum_rotation_ += rotation;
+        ++count_;
+    }
+
+    // 最近一次比对的误差是否在容差内
+    bool withinTolerance(double position_tolerance, double rotation_tolerance) const {
+        return count_ > 0 && last_position_ <= position_tolerance && last_rotation_ <= rotation_tolerance;
+    }
+
+    uint64_t count() const { return count_; }
+    double lastPositionError() const { return last_position_; }
+    double lastRotationError() const { return last_rotation_; }
+    double maxPositionError() const { return max_position_; }
+    double maxRotationError() const { return max_rotation_; }
+
+    void print(const char* name) const {
+        if (count_ == 0) {
+            std::cout << name << ": n=0" << std::endl;
+            return;
+        }
+        std::cout << name << ": n=" << count_ << " position mean=" << sum_position_ / count_ * 1e3
+                  << "mm max=" << max_position_ * 1e3 << "mm rotation mean=" << sum_rotation_ / count_ * 1e3
+                  << "mrad max=" << max_rotation_ * 1e3 << "mrad" << std::endl;
+    }
+
+private:
+    double last_position_ = 0.0;
+    double last_rotation_ = 0.0;
+    double max_position_ = 0.0;
+    double max_rotation_ = 0.0;
+    double sum_position_ = 0.0;
+    double sum_rotation_ = 0.0;
+    uint64_t count_ = 0;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+
+// 对数分桶的延迟直方图（HDR 风格），每个 2 的幂区间再均分为 16 个子桶，相对误差约 6%
+// 记录范围 0 ~ 2^40 ns（约 18 分钟），超出的值记入最后一个桶
+// 单写者：record() 只由一个线程调用，不分配内存、不加锁；其它线程可随时读取百分位
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr uint64_t kSubCount = 1ull << kSubBits;
+    static constexpr int kMaxBits = 40;
+    static constexpr std::size_t kBucketCount = (kMaxBits - kSubBits + 1) * kSubCount;
+
+    void record(uint64_t ns) {
+        std::size_t index = bucketIndex(ns);
+        buckets_[index].store(buckets_[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (ns > max_.load(std::memory_order_relaxed)) {
+            max_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    void record(std::chrono::steady_clock::duration d) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        record(static_cast<uint64_t>(ns > 0 ? ns : 0));
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // 返回第 q 分位（0 ~ 1）所在桶的上界 (ns)
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(q * total);
+        if (target >= total) {
+            target = total - 1;
+        }
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen > target) {
+                uint64_t upper = bucketUpper(i);
+                uint64_t max_ns = max();
+                return upper < max_ns ? upper : max_ns;
+            }
+        }
+        return max();
+    }
+
+    // 以微秒打印 p50/p99/p99.9/max
+    void print(const char* name) const {
+        std::cout << name << ": n=" << count()
+                  << " p50=" << percentile(0.5) * 1e-3 << "us"
+                  << " p99=" << percentile(0.99) * 1e-3 << "us"
+                  << " p99.9=" << percentile(0.999) * 1e-3 << "us"
+                  << " max=" << max() * 1e-3 << "us" << std::endl;
+    }
+
+    static std::size_t bucketIndex(uint64_t ns) {
+        if (ns < kSubCount) {
+            return static_cast<std::size_t>(ns);
+        }
+        int exponent = 63 - __builtin_clzll(ns);
+        if (exponent >= kMaxBits) {
+            return kBucketCount - 1;
+        }
+        int shift = exponent - kSubBits;
+        uint64_t sub = (ns >> shift) - kSubCount;
+        return static_cast<std::size_t>((shift + 1) * kSubCount + sub);
+    }
+
+    static uint64_t bucketUpper(std::size_t index) {
+        if (index < kSubCount) {
+            return index;
+        }
+        int shift = static_cast<int>(index / kSubCount) - 1;
+        uint64_t sub = index % kSubCount;
+        return ((kSubCount + sub + 1) << shift) - 1;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "spsc_queue.h"
+
+
+// 将发送端时钟的时间映射到本地 steady_clock（秒）
+// 偏移取最近 window 秒内 (本地接收时间 - 发送时间) 的最小值，即网络延迟最小的那条消息，
+// 延迟抖动只会让偏移偏大而被忽略；窗口使偏移可以跟随两端时钟的漂移
+class ClockMapper {
+public:
+    static constexpr std::size_t kCapacity = 1024;
+
+    explicit ClockMapper(double window = 10.0) : window_(window) {}
+
+    // 记录一条消息的发送时间与本地接收时间
+    void update(double sent, double local) {
+        double offset = local - sent;
+        // 单调队列：队尾不小于新值的样本不可能再成为最小值
+        while (tail_ > head_ && samples_[(tail_ - 1) % kCapacity].offset >= offset) {
+            --tail_;
+        }
+        if (tail_ - head_ == kCapacity) {
+            ++head_;
+        }
+        samples_[tail_ % kCapacity] = {local, offset};
+        ++tail_;
+        while (samples_[head_ % kCapacity].local < local - window_) {
+            ++head_;
+        }
+        ++count_;
+    }
+
+    bool valid() const { return count_ > 0; }
+
+    // 本地时间 = 发送端时间 + 最小偏移
+    double map(double sender_time) const { return sender_time + offset(); }
+
+    double offset() const { return samples_[head_ % kCapacity].offset; }
+
+    uint64_t count() const { return count_; }
+
+private:
+    struct Sample {
+        double local;
+        double offset;
+    };
+
+    double window_;
+    std::array<Sample, kCapacity> samples_ = {};
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+    uint64_t count_ = 0;
+};
+
+// 固定延迟的播放缓冲（类似 jitter buffer）：写者按到达顺序放入带计划执行时刻 due_time 的记录，
+// 读者每周期取出所有已到期的记录，保留最新的一条作为当前记录，未到期的留在缓冲中
+// T 需要有 std::chrono::steady_clock::time_point due_time 成员
+template <class T, std::size_t Capacity>
+class PlayoutBuffer {
+public:
+    PlayoutBuffer() = default;
+    PlayoutBuffer(const PlayoutBuffer&) = delete;
+    PlayoutBuffer& operator=(const PlayoutBuffer&) = delete;
+
+    // 写者线程调用，缓冲区满时丢弃并返回 false
+    bool push(const T& value) {
+        if (!queue_.push(value)) {
+            overflow_.store(overflow_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // 读者线程调用，取出 now 之前到期的记录，当前记录有更新时返回 true
+    bool release(std::chrono::steady_clock::time_point now) {
+        bool updated = false;
+        while (const T* next = queue_.peek()) {
+            if (next->due_time > now) {
+                break;
+            }
+            current_ = *next;
+            queue_.discard();
+            if (updated) {
+                // 同一周期内到期的多条记录只有最新的一条生效
+                skipped_.store(skipped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            updated = true;
+            released_.store(released_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        return updated;
+    }
+
+    // 丢弃所有未到期的记录并把当前记录设为 value，只能在读者线程停止时调用
+    void reset(const T& value) {
+        while (queue_.peek()) {
+            queue_.discard();
+        }
+        current_ = value;
+    }
+
+    // 读者线程调用，返回最近一次到期的记录
+    const T& current() const { return current_; }
+
+    std::size_t pending() const { return queue_.size(); }
+    uint64_t released() const { return released_.load(std::memory_order_relaxed); }
+    uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+    uint64_t overflow() const { return overflow_.load(std::memory_order_relaxed); }
+
+    void print(const char* name) const {
+        std::cout << name << ": released=" << released() << " skipped=" << skipped() << " overflow=" << overflow()
+                  << " pending=" << pending() << std::endl;
+    }
+
+private:
+    SpscQueue<T, Capacity> queue_;
+    T current_;
+    std::atomic<uint64_t> released_{0};
+    std::atomic<uint64_t> skipped_{0};
+    std::atomic<uint64_t> overflow_{0};
+};
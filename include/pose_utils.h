@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+
+// 行主序 N×N 矩阵乘法 result = A * B
+template <std::size_t N>
+void multiplyMatrices(const std::array<double, N * N>& A, const std::array<double, N * N>& B, std::array<double, N * N>& result) {
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            result[i * N + j] = 0;
+            for (std::size_t k = 0; k < N; ++k) {
+                result[i * N + j] += A[i * N + k] * B[k * N + j];
+            }
+        }
+    }
+}
+
+// 从行主序 4×4 变换矩阵中提取 [x, y, z, roll, pitch, yaw]
+inline void extractXYZRPY(const std::array<double, 16>& transform, std::array<double, 6>& xyzrpy) {
+    xyzrpy[0] = transform[3];  // X
+    xyzrpy[1] = transform[7];  // Y
+    xyzrpy[2] = transform[11]; // Z
+
+    double r00 = transform[0];
+    double r01 = transform[1];
+    double r10 = transform[4];
+    double r11 = transform[5];
+    double r20 = transform[8];
+    double r21 = transform[9];
+    double r22 = transform[10];
+
+    double pitch = std::asin(-r20);
+    double cos_pitch = std::cos(pitch);
+
+    const double EPSILON = 1e-6;
+
+    double roll, yaw;
+
+    if (std::abs(cos_pitch) > EPSILON) {
+        roll = std::atan2(r21, r22);
+        yaw = std::atan2(r10, r00);
+    } else {
+        // Gimbal lock
+        roll = 0.0;
+        if (pitch < 0) {
+            yaw = std::atan2(-r01, r11);
+        } else {
+            yaw = std::atan2(r01, r11);
+        }
+    }
+
+    xyzrpy[3] = roll;
+    xyzrpy[4] = pitch;
+    xyzrpy[5] = yaw;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+
+// 单位四元数 w + xi + yj + zk
+struct Quaternion {
+    double w = 1.0;
+    double x = 0.0;
+    double y = 0.0;
+    double z = 0.0;
+};
+
+// a * b
+inline Quaternion quaternionMultiply(const Quaternion& a, const Quaternion& b) {
+    return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+            a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+// 由旋转向量（轴 * 角度）得到四元数，角度很小时用泰勒展开代替 sin/cos
+inline Quaternion quaternionFromRotationVector(const std::array<double, 3>& v) {
+    double theta2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    double w, s;
+    if (theta2 < 1e-6) {
+        // theta < 1e-3 时截断误差小于 1e-15
+        w = 1.0 - theta2 * (1.0 / 8.0) + theta2 * theta2 * (1.0 / 384.0);
+        s = 0.5 - theta2 * (1.0 / 48.0);
+    } else {
+        double theta = std::sqrt(theta2);
+        w = std::cos(0.5 * theta);
+        s = std::sin(0.5 * theta) / theta;
+    }
+    return {w, v[0] * s, v[1] * s, v[2] * s};
+}
+
+// 共轭，对单位四元数即为逆
+inline Quaternion quaternionConjugate(const Quaternion& q) {
+    return {q.w, -q.x, -q.y, -q.z};
+}
+
+inline double quaternionDot(const Quaternion& a, const Quaternion& b) {
+    return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// 单位四元数对应的旋转向量，取转角不超过 pi 的一侧
+inline std::array<double, 3> quaternionToRotationVector(const Quaternion& q) {
+    double sign = q.w < 0.0 ? -1.0 : 1.0;
+    double s = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+    double scale;
+    if (s < 1e-8) {
+        // sin(theta/2) 很小时 theta / sin(theta/2) 趋于 2 / w
+        scale = 2.0 / std::fabs(q.w);
+    } else {
+        scale = 2.0 * std::atan2(s, std::fabs(q.w)) / s;
+    }
+    scale *= sign;
+    return {q.x * scale, q.y * scale, q.z * scale};
+}
+
+// 接近单位长度时的归一化：用一步牛顿迭代近似 1/sqrt(n)，不需要开方
+inline void quaternionNormalizeFast(Quaternion& q) {
+    double n2 = q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z;
+    double scale = 0.5 * (3.0 - n2);
+    q.w *= scale;
+    q.x *= scale;
+    q.y *= scale;
+    q.z *= scale;
+}
+
+inline void quaternionNormalize(Quaternion& q) {
+    double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    q.w /= n;
+    q.x /= n;
+    q.y /= n;
+    q.z /= n;
+}
+
+// 由行主序 4x4 变换矩阵的旋转部分得到四元数（Shepperd 方法，数值稳定）
+inline Quaternion quaternionFromMatrix(const std::array<double, 16>& T) {
+    double r00 = T[0], r01 = T[1], r02 = T[2];
+    double r10 = T[4], r11 = T[5], r12 = T[6];
+    double r20 = T[8], r21 = T[9], r22 = T[10];
+    double trace = r00 + r11 + r22;
+    Quaternion q;
+    if (trace > 0.0) {
+        double s = 2.0 * std::sqrt(1.0 + trace);
+        q = {0.25 * s, (r21 - r12) / s, (r02 - r20) / s, (r10 - r01) / s};
+    } else if (r00 > r11 && r00 > r22) {
+        double s = 2.0 * std::sqrt(1.0 + r00 - r11 - r22);
+        q = {(r21 - r12) / s, 0.25 * s, (r01 + r10) / s, (r02 + r20) / s};
+    } else if (r11 > r22) {
+        double s = 2.0 * std::sqrt(1.0 + r11 - r00 - r22);
+        q = {(r02 - r20) / s, (r01 + r10) / s, 0.25 * s, (r12 + r21) / s};
+    } else {
+        double s = 2.0 * std::sqrt(1.0 + r22 - r00 - r11);
+        q = {(r10 - r01) / s, (r02 + r20) / s, (r12 + r21) / s, 0.25 * s};
+    }
+    quaternionNormalize(q);
+    return q;
+}
+
+// 将单位四元数写入行主序 4x4 变换矩阵的旋转部分，平移部分不变
+inline void quaternionToMatrix(const Quaternion& q, std::array<double, 16>& T) {
+    double xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    T[0] = 1.0 - 2.0 * (yy + zz);
+    T[1] = 2.0 * (xy - wz);
+    T[2] = 2.0 * (xz + wy);
+    T[4] = 2.0 * (xy + wz);
+    T[5] = 1.0 - 2.0 * (xx + zz);
+    T[6] = 2.0 * (yz - wx);
+    T[8] = 2.0 * (xz - wy);
+    T[9] = 2.0 * (yz + wx);
+    T[10] = 1.0 - 2.0 * (xx + yy);
+}
+
+// 球面线性插值，h 在 [0, 1] 之间，自动取较短的一侧
+inline Quaternion quaternionSlerp(const Quaternion& a, const Quaternion& b, double h) {
+    std::array<double, 3> r = quaternionToRotationVector(quaternionMultiply(quaternionConjugate(a), b));
+    return quaternionMultiply(a, quaternionFromRotationVector({r[0] * h, r[1] * h, r[2] * h}));
+}
+
+// SQUAD 的中间控制点 s_i = q_i * exp(-(log(q_i^-1 q_{i+1}) + log(q_i^-1 q_{i-1})) / 4)
+inline Quaternion squadControlPoint(const Quaternion& prev, const Quaternion& q, const Quaternion& next) {
+    Quaternion inv = quaternionConjugate(q);
+    std::array<double, 3> r_next = quaternionToRotationVector(quaternionMultiply(inv, next));
+    std::array<double, 3> r_prev = quaternionToRotationVector(quaternionMultiply(inv, prev));
+    return quaternionMultiply(q, quaternionFromRotationVector({-(r_next[0] + r_prev[0]) * 0.25,
+                                                               -(r_next[1] + r_prev[1]) * 0.25,
+                                                               -(r_next[2] + r_prev[2]) * 0.25}));
+}
+
+// 球面四边形插值，在 q0、q1 之间以 s0、s1 为控制点，经过路点时角速度连续
+inline Quaternion quaternionSquad(const Quaternion& q0, const Quaternion& q1, const Quaternion& s0, const Quaternion& s1, double h) {
+    return quaternionSlerp(quaternionSlerp(q0, q1, h), quaternionSlerp(s0, s1, h), 2.0 * h * (1.0 - h));
+}
+
+// 以四元数形式累积姿态增量，每步归一化，长时间积分也不会偏离 SO(3)
+// 只在交给 SDK 时才转换为矩阵
+class OrientationIntegrator {
+public:
+    void reset(const std::array<double, 16>& T) { q_ = quaternionFromMatrix(T); }
+
+    // 在基坐标系下旋转 rotation_vector：R_new = dR * R
+    void integrate(const std::array<double, 3>& rotation_vector) {
+        q_ = quaternionMultiply(quaternionFromRotationVector(rotation_vector), q_);
+        quaternionNormalizeFast(q_);
+    }
+
+    void toMatrix(std::array<double, 16>& T) const { quaternionToMatrix(q_, T); }
+
+    const Quaternion& quaternion() const { return q_; }
+
+private:
+    Quaternion q_;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+
+// 实时线程堆分配检查：定义 RT_ALLOC_GUARD 时（Debug 构建）统计在 arm/disarm 之间
+// 当前线程调用的 malloc/free 次数，否则全部为空操作
+// 用法：回调开始时 rtAllocGuardArm()，构造返回给 SDK 的对象前 rtAllocGuardDisarm()
+#ifdef RT_ALLOC_GUARD
+
+void rtAllocGuardArm();
+void rtAllocGuardDisarm();
+uint64_t rtAllocGuardMallocs();
+uint64_t rtAllocGuardFrees();
+void rtAllocGuardPrint(const char* name);
+
+#else
+
+inline void rtAllocGuardArm() {}
+inline void rtAllocGuardDisarm() {}
+inline uint64_t rtAllocGuardMallocs() { return 0; }
+inline uint64_t rtAllocGuardFrees() { return 0; }
+inline void rtAllocGuardPrint(const char*) {}
+
+#endif
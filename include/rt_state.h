@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "rokae/robot.h"
+#include "rokae/utility.h"
+#include "pose_utils.h"
+#include "kinematics.h"
+
+
+// 每个控制周期的机器人状态，在回调外预分配，回调中原地填充，不做任何堆分配
+struct RobotState {
+    std::array<double, 7> joint_pos = {0.0};
+    std::array<double, 7> joint_vel = {0.0};
+    std::array<double, 7> joint_torque = {0.0};
+    std::array<double, 16> flange_in_base = {0.0};  // 法兰在基坐标系中的位姿（行主序）
+    std::array<double, 16> tcp_in_base = {0.0};     // flange_in_base * tcp_frame
+    std::array<double, 6> tcp_posture = {0.0};      // tcp 的 [x, y, z, roll, pitch, yaw]
+    std::chrono::steady_clock::time_point stamp;    // 读取状态的时刻
+    uint64_t cycle = 0;                             // 已读取的周期数
+    bool valid = false;                             // 本周期的数据是否全部读取成功
+};
+
+// 需要控制器在每个周期推送的状态字段，传给 robot.startReceiveRobotState()
+inline std::vector<std::string> robotStateFields() {
+    return {rokae::RtSupportedFields::jointPos_m,
+            rokae::RtSupportedFields::jointVel_m,
+            rokae::RtSupportedFields::tau_m,
+            rokae::RtSupportedFields::tcpPose_m};
+}
+
+inline void updateTcpPose(const std::array<double, 16>& tcp_frame, RobotState& state) {
+    multiplyTransforms(state.flange_in_base, tcp_frame, state.tcp_in_base);
+    extractXYZRPY(state.tcp_in_base, state.tcp_posture);
+}
+
+// 从控制器随周期推送的数据中读取状态，要求 setControlLoop(..., useStateDataInLoop=true)
+// 此时 SDK 在调用回调前已经更新了状态数据，getStateData 只是拷贝，不产生通信
+// 注意 tcpPose_m 为法兰在基坐标系中的位姿，与 robot.posture(flangeInBase) 相同，不受 setEndEffectorFrame 影响
+// analytic_fk 时法兰位姿由关节角度经正运动学计算，不读取 tcpPose_m
+template <class Robot>
+bool readRobotStateInLoop(Robot& robot, const std::array<double, 16>& tcp_frame, RobotState& state, bool analytic_fk = false) {
+    state.stamp = std::chrono::steady_clock::now();
+    bool ok = robot.getStateData(rokae::RtSupportedFields::jointPos_m, state.joint_pos) == 0;
+    ok = robot.getStateData(rokae::RtSupportedFields::jointVel_m, state.joint_vel) == 0 && ok;
+    ok = robot.getStateData(rokae::RtSupportedFields::tau_m, state.joint_torque) == 0 && ok;
+    if (analytic_fk) {
+        forwardKinematics(state.joint_pos, state.flange_in_base);
+    } else {
+        ok = robot.getStateData(rokae::RtSupportedFields::tcpPose_m, state.flange_in_base) == 0 && ok;
+    }
+    updateTcpPose(tcp_frame, state);
+    state.valid = ok;
+    ++state.cycle;
+    return ok;
+}
+
+// 旧的读取方式：每个周期调用 robot.posture()/jointPos() 查询，用于对比耗时
+// 不查询关节速度和力矩，它们保持为上一次的值；analytic_fk 时只查询关节角度，法兰位姿由正运动学计算
+template <class Robot>
+bool readRobotStateQuery(Robot& robot, const std::array<double, 16>& tcp_frame, RobotState& state, std::error_code& ec,
+                         bool analytic_fk = false) {
+    state.stamp = std::chrono::steady_clock::now();
+    if (analytic_fk) {
+        state.joint_pos = robot.jointPos(ec);
+        forwardKinematics(state.joint_pos, state.flange_in_base);
+    } else {
+        std::array<double, 6> posture_flange = robot.posture(rokae::CoordinateType::flangeInBase, ec);
+        rokae::Utils::postureToTransArray(posture_flange, state.flange_in_base);
+        state.joint_pos = robot.jointPos(ec);
+    }
+    updateTcpPose(tcp_frame, state);
+    state.valid = !ec;
+    ++state.cycle;
+    return state.valid;
+}
+
+// zmq_sender 发布的状态快照，机械臂与夹爪共用一个时间戳和序号
+struct RobotSnapshot {
+    uint64_t seq = 0;                           // 实时回调的周期序号
+    int64_t stamp_ns = 0;                       // steady_clock 时间戳 (纳秒)
+    std::array<double, 6> tcp_posture = {0.0};  // tcp 的 [x, y, z, roll, pitch, yaw]
+    std::array<double, 7> joint_pos = {0.0};
+    double gripper_position = 0.0;              // 归一化到 [0, 1]
+};
+
+inline void fillSnapshot(const RobotState& state, double gripper_position, RobotSnapshot& snapshot) {
+    snapshot.seq = state.cycle;
+    snapshot.stamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(state.stamp.time_since_epoch()).count();
+    snapshot.tcp_posture = state.tcp_posture;
+    snapshot.joint_pos = state.joint_pos;
+    snapshot.gripper_position = gripper_position;
+}
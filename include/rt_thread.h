@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+
+// 单个线程的调度配置
+struct ThreadPlacement {
+    const char* role;
+    int priority;                   // SCHED_FIFO 优先级 [1, 99]，0 表示保持普通调度 SCHED_OTHER
+    std::vector<int> cpus;          // 绑定的 CPU 编号，为空表示不限制
+};
+
+// 线程实际生效的调度情况，由线程自身写入，主线程在 ready 之后读取打印
+struct PlacementResult {
+    int policy = SCHED_OTHER;
+    int priority = 0;
+    cpu_set_t cpus;
+    int sched_error = 0;            // 设置调度策略失败时的 errno，通常为缺少 CAP_SYS_NICE 时的 EPERM
+    int affinity_error = 0;         // 设置 CPU 亲和性失败时的 errno
+    std::atomic<bool> ready{false};
+};
+
+// 预先访问一段栈空间，避免实时线程第一次用到时发生缺页
+template <std::size_t Bytes = 256 * 1024>
+__attribute__((noinline)) void prefaultStack() {
+    volatile unsigned char stack[Bytes];
+    for (std::size_t i = 0; i < Bytes; i += 4096) {
+        stack[i] = 0;
+    }
+    (void)stack[0];
+}
+
+// 锁定当前和以后的全部内存页，失败时返回 errno（权限或 RLIMIT_MEMLOCK 不足），成功返回 0
+inline int lockProcessMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return errno;
+    }
+    return 0;
+}
+
+// 当前线程的内核线程号，可以在其它线程中用来设置该线程的调度
+inline pid_t currentThreadId() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+// 在线程 tid 上应用调度配置，可以由其它线程调用，任何一项失败都保留原设置继续运行，结果写入 result
+// 用于 SDK 创建的控制线程：设置与迁移不占用该线程的控制周期，线程已退出时得到 ESRCH
+// 不会预先访问该线程的栈，它的栈在创建时已由 mlockall(MCL_FUTURE) 锁定调入
+inline void applyThreadPlacement(pid_t tid, const ThreadPlacement& placement, PlacementResult& result) {
+    if (!placement.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu : placement.cpus) {
+            if (cpu >= 0 && cpu < cpu_count) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (CPU_COUNT(&set) == 0) {
+            result.affinity_error = EINVAL;
+        } else {
+            result.affinity_error = sched_setaffinity(tid, sizeof(set), &set) == 0 ? 0 : errno;
+        }
+    }
+
+    if (placement.priority > 0) {
+        sched_param param;
+        param.sched_priority = placement.priority;
+        result.sched_error = sched_setscheduler(tid, SCHED_FIFO, &param) == 0 ? 0 : errno;
+    }
+
+    sched_param param;
+    result.policy = sched_getscheduler(tid);
+    result.priority = sched_getparam(tid, &param) == 0 ? param.sched_priority : 0;
+    CPU_ZERO(&result.cpus);
+    sched_getaffinity(tid, sizeof(result.cpus), &result.cpus);
+    result.ready.store(true, std::memory_order_release);
+}
+
+// 在当前线程上应用调度配置并预先访问栈空间
+// 不分配内存，可以在实时回调中调用
+inline void applyThreadPlacement(const ThreadPlacement& placement, PlacementResult& result) {
+    applyThreadPlacement(currentThreadId(), placement, result);
+    prefaultStack();
+}
+
+inline void printPlacement(const ThreadPlacement& placement, const PlacementResult& result) {
+    if (!result.ready.load(std::memory_order_acquire)) {
+        std::cout << "  " << placement.role << ": 未启动" << std::endl;
+        return;
+    }
+    std::cout << "  " << placement.role << ": "
+              << (result.policy == SCHED_FIFO ? "SCHED_FIFO" : result.policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER")
+              << " prio=" << result.priority << " cpus=[";
+    bool first = true;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &result.cpus)) {
+            std::cout << (first ? "" : ",") << cpu;
+            first = false;
+        }
+    }
+    std::cout << "]";
+    if (result.sched_error) {
+        std::cout << " (未能设置实时调度: " << std::strerror(result.sched_error) << "，需要 CAP_SYS_NICE 或 rtprio 限制)";
+    }
+    if (result.affinity_error) {
+        std::cout << " (未能绑定 CPU: " << std::strerror(result.affinity_error) << ")";
+    }
+    std::cout << std::endl;
+}
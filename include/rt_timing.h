@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+
+// 回调耗时统计，只由实时线程写入，停止控制循环后在主线程读取打印
+struct DurationStats {
+    uint64_t count = 0;
+    uint64_t overruns = 0;     // 超过 budget 的次数
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    double budget_ms = 1.0;
+
+    void add(std::chrono::steady_clock::duration d) {
+        double ms = std::chrono::duration<double, std::milli>(d).count();
+        ++count;
+        total_ms += ms;
+        if (ms > max_ms) max_ms = ms;
+        if (ms > budget_ms) ++overruns;
+    }
+
+    void print(const char* name) const {
+        double mean_ms = count > 0 ? total_ms / count : 0.0;
+        std::cout << name << ": n=" << count << " mean=" << mean_ms << "ms max=" << max_ms
+                  << "ms >" << budget_ms << "ms=" << overruns << std::endl;
+    }
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "kinematics.h"
+#include "rotation.h"
+
+
+// 半空间 n · p <= d，n 为单位向量
+struct Halfspace {
+    double nx, ny, nz;
+    double d;
+};
+
+// 轴对齐的长方体 [lower, upper]，可在编译期生成
+constexpr std::array<Halfspace, 6> boxHalfspaces(const std::array<double, 3>& lower, const std::array<double, 3>& upper) {
+    return {{{1.0, 0.0, 0.0, upper[0]},
+             {-1.0, 0.0, 0.0, -lower[0]},
+             {0.0, 1.0, 0.0, upper[1]},
+             {0.0, -1.0, 0.0, -lower[1]},
+             {0.0, 0.0, 1.0, upper[2]},
+             {0.0, 0.0, -1.0, -lower[2]}}};
+}
+
+struct SafetyLimits {
+    double max_linear_step = 5e-4;   // tcp 每周期的最大位移 (米)
+    double max_angular_step = 1e-3;  // tcp 每周期的最大转角 (弧度)
+    std::array<double, 7> joint_lower = {0.0};
+    std::array<double, 7> joint_upper = {0.0};
+    std::array<double, 7> max_joint_step = {0.0};  // 每周期各关节的最大变化 (弧度)
+};
+
+// 各项限制生效的周期数，由实时回调写入，其它线程可随时读取
+struct SafetyCounters {
+    std::atomic<uint64_t> non_finite{0};
+    std::atomic<uint64_t> workspace{0};
+    std::atomic<uint64_t> linear_step{0};
+    std::atomic<uint64_t> angular_step{0};
+    std::atomic<uint64_t> joint_limit{0};
+    std::atomic<uint64_t> joint_step{0};
+
+    static void increment(std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void print(const char* name) const {
+        std::cout << name << ": non_finite=" << non_finite << " workspace=" << workspace << " linear_step=" << linear_step
+                  << " angular_step=" << angular_step << " joint_limit=" << joint_limit << " joint_step=" << joint_step
+                  << std::endl;
+    }
+};
+
+// 实时回调返回前对目标做的安全限制，每次调用的计算量固定（有上限），不分配内存
+// 含 NaN 或无穷大的目标不做任何比较，直接保持上一次的输出
+// 笛卡尔目标：tcp 位置限制在凸区域（半空间的交集）内，再限制相对上一次输出的位移与转角
+// 关节目标：先限制相对上一次输出的变化量，再限制在软限位内；给出 tcp_frame 时再由正运动学把 tcp 位置限制在同一区域内
+// 上一次的输出在区域外时（以区域外的位置启动或切换模式），每个半空间的边界放宽到上一次的位置，
+// 只允许不远离区域的运动，保持不动的目标不会被拉向区域
+// 只由实时回调访问，切换控制模式或重新开始时用 reset 设置上一次的输出
+template <std::size_t Planes>
+class SafetyFilter {
+public:
+    // 投影到各个半空间的轮数，长方体一轮即为最近点，一般的凸区域轮数越多越接近
+    static constexpr int kPasses = 3;
+    // 关节目标的 tcp 越出区域时，在上一次输出到目标的连线上二分查找仍在区域内的最远点的次数
+    static constexpr int kBisections = 8;
+
+    SafetyFilter(const std::array<Halfspace, Planes>& workspace, const SafetyLimits& limits, SafetyCounters& counters)
+        : workspace_(workspace), limits_(limits), counters_(counters) {}
+
+    void reset(const std::array<double, 16>& pose) {
+        last_pose_ = pose;
+        last_orientation_ = quaternionFromMatrix(pose);
+    }
+
+    void reset(const std::array<double, 7>& joints) {
+        last_joints_ = joints;
+        last_tcp_valid_ = false;
+    }
+
+    // 限制 tcp 目标位姿，有任何限制生效时返回 true
+    bool filter(std::array<double, 16>& pose) {
+        if (!allFinite(pose)) {
+            pose = last_pose_;
+            SafetyCounters::increment(counters_.non_finite);
+            return true;
+        }
+        bool limited = false;
+        double p[3] = {pose[3], pose[7], pose[11]};
+        const double last_p[3] = {last_pose_[3], last_pose_[7], last_pose_[11]};
+        bool outside = false;
+        for (int pass = 0; pass < kPasses; ++pass) {
+            for (const Halfspace& h : workspace_) {
+                double s = excess(h, p, last_p);
+                if (s > 0.0) {
+                    p[0] -= s * h.nx;
+                    p[1] -= s * h.ny;
+                    p[2] -= s * h.nz;
+                    outside = true;
+                }
+            }
+        }
+        if (outside) {
+            SafetyCounters::increment(counters_.workspace);
+            limited = true;
+        }
+
+        double dx = p[0] - last_pose_[3];
+        double dy = p[1] - last_pose_[7];
+        double dz = p[2] - last_pose_[11];
+        double step = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (step > limits_.max_linear_step) {
+            double k = limits_.max_linear_step / step;
+            p[0] = last_pose_[3] + k * dx;
+            p[1] = last_pose_[7] + k * dy;
+            p[2] = last_pose_[11] + k * dz;
+            SafetyCounters::increment(counters_.linear_step);
+            limited = true;
+        }
+        pose[3] = p[0];
+        pose[7] = p[1];
+        pose[11] = p[2];
+
+        // 转角 = 2 acos(|<q_last, q>|)，超出时从上一次的姿态 SLERP 过去一部分
+        Quaternion q = quaternionFromMatrix(pose);
+        double dot = std::fmin(1.0, std::fabs(quaternionDot(last_orientation_, q)));
+        double angle = 2.0 * std::acos(dot);
+        if (angle > limits_.max_angular_step) {
+            q = quaternionSlerp(last_orientation_, q, limits_.max_angular_step / angle);
+            quaternionToMatrix(q, pose);
+            SafetyCounters::increment(counters_.angular_step);
+            limited = true;
+        }
+        last_pose_ = pose;
+        last_orientation_ = q;
+        return limited;
+    }
+
+    // 限制关节目标，有任何限制生效时返回 true
+    bool filter(std::array<double, 7>& joints) {
+        if (!allFinite(joints)) {
+            joints = last_joints_;
+            SafetyCounters::increment(counters_.non_finite);
+            return true;
+        }
+        bool step_limited = false;
+        bool range_limited = false;
+        for (std::size_t i = 0; i < joints.size(); ++i) {
+            double step = joints[i] - last_joints_[i];
+            double max_step = limits_.max_joint_step[i];
+            if (std::fabs(step) > max_step) {
+                joints[i] = last_joints_[i] + std::copysign(max_step, step);
+                step_limited = true;
+            }
+            if (joints[i] < limits_.joint_lower[i]) {
+                joints[i] = limits_.joint_lower[i];
+                range_limited = true;
+            } else if (joints[i] > limits_.joint_upper[i]) {
+                joints[i] = limits_.joint_upper[i];
+                range_limited = true;
+            }
+        }
+        if (step_limited) {
+            SafetyCounters::increment(counters_.joint_step);
+        }
+        if (range_limited) {
+            SafetyCounters::increment(counters_.joint_limit);
+        }
+        last_joints_ = joints;
+        last_tcp_valid_ = false;
+        return step_limited || range_limited;
+    }
+
+    // 限制关节目标，并由正运动学把 tcp 位置限制在区域内：越出区域时退回到上一次输出与目标连线上仍在区域内的点，
+    // 最多做 1 + kBisections 次正运动学；有任何限制生效时返回 true
+    bool filter(std::array<double, 7>& joints, const std::array<double, 16>& tcp_frame) {
+        std::array<double, 16> tcp;
+        if (!last_tcp_valid_) {
+            forwardKinematicsTcp(last_joints_, tcp_frame, tcp);
+            last_tcp_ = {tcp[3], tcp[7], tcp[11]};
+        }
+        const std::array<double, 7> from = last_joints_;
+        const double last_p[3] = {last_tcp_[0], last_tcp_[1], last_tcp_[2]};
+        bool limited = filter(joints);
+
+        forwardKinematicsTcp(joints, tcp_frame, tcp);
+        double p[3] = {tcp[3], tcp[7], tcp[11]};
+        if (!inside(p, last_p)) {
+            // from 本身满足放宽后的边界，joints 不满足，二分保留满足的一端
+            double lo = 0.0;
+            double hi = 1.0;
+            p[0] = last_p[0];
+            p[1] = last_p[1];
+            p[2] = last_p[2];
+            std::array<double, 7> q;
+            for (int it = 0; it < kBisections; ++it) {
+                double mid = 0.5 * (lo + hi);
+                for (std::size_t i = 0; i < q.size(); ++i) {
+                    q[i] = from[i] + mid * (joints[i] - from[i]);
+                }
+                forwardKinematicsTcp(q, tcp_frame, tcp);
+                double mid_p[3] = {tcp[3], tcp[7], tcp[11]};
+                if (inside(mid_p, last_p)) {
+                    lo = mid;
+                    p[0] = mid_p[0];
+                    p[1] = mid_p[1];
+                    p[2] = mid_p[2];
+                } else {
+                    hi = mid;
+                }
+            }
+            for (std::size_t i = 0; i < joints.size(); ++i) {
+                joints[i] = from[i] + lo * (joints[i] - from[i]);
+            }
+            SafetyCounters::increment(counters_.workspace);
+            limited = true;
+        }
+        last_joints_ = joints;
+        last_tcp_ = {p[0], p[1], p[2]};
+        last_tcp_valid_ = true;
+        return limited;
+    }
+
+private:
+    // p 越出半空间的距离，边界放宽到上一次的位置 last_p：last_p 在区域外时只限制继续远离
+    static double excess(const Halfspace& h, const double* p, const double* last_p) {
+        double bound = std::fmax(h.d, h.nx * last_p[0] + h.ny * last_p[1] + h.nz * last_p[2]);
+        return h.nx * p[0] + h.ny * p[1] + h.nz * p[2] - bound;
+    }
+
+    bool inside(const double* p, const double* last_p) const {
+        for (const Halfspace& h : workspace_) {
+            if (excess(h, p, last_p) > 0.0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // NaN 与任何值比较都为 false，会穿过所有的限制，必须先单独检查
+    template <std::size_t N>
+    static bool allFinite(const std::array<double, N>& values) {
+        for (double v : values) {
+            if (!std::isfinite(v)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::array<Halfspace, Planes> workspace_;
+    SafetyLimits limits_;
+    SafetyCounters& counters_;
+    std::array<double, 16> last_pose_ = {0.0};
+    Quaternion last_orientation_;
+    std::array<double, 7> last_joints_ = {0.0};
+    std::array<double, 3> last_tcp_ = {0.0};  // last_joints_ 对应的 tcp 位置
+    bool last_tcp_valid_ = false;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+
+// 单写者多读者的顺序锁，写者 wait-free，读者发现数据被改写时重试
+// 数据按 8 字节分块存放在原子变量中，读写都不会产生数据竞争
+template <class T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock 只能保存可平凡复制的类型");
+
+public:
+    SeqLock() {
+        T value{};
+        store(value);
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // 写者线程调用，版本号为奇数时表示正在写入
+    void store(const T& value) {
+        uint64_t words[kWords] = {0};
+        std::memcpy(words, &value, sizeof(T));
+
+        uint64_t version = version_.load(std::memory_order_relaxed);
+        version_.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i) {
+            data_[i].store(words[i], std::memory_order_relaxed);
+        }
+        version_.store(version + 2, std::memory_order_release);
+    }
+
+    // 读者线程调用，读到撕裂的数据时重试，返回读取时的版本号
+    uint64_t load(T& value) const {
+        uint64_t words[kWords];
+        while (true) {
+            uint64_t before = version_.load(std::memory_order_acquire);
+            if (!(before & 1)) {
+                for (std::size_t i = 0; i < kWords; ++i) {
+                    words[i] = data_[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version_.load(std::memory_order_relaxed) == before) {
+                    std::memcpy(&value, words, sizeof(T));
+                    return before / 2;
+                }
+            }
+            retries_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t retries() const { return retries_.load(std::memory_order_relaxed); }
+
+    void print(const char* name) const {
+        std::cout << name << ": version=" << version_.load(std::memory_order_relaxed) / 2
+                  << " retries=" << retries() << std::endl;
+    }
+
+private:
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> version_{0};
+    std::atomic<uint64_t> data_[kWords];
+    alignas(64) mutable std::atomic<uint64_t> retries_{0};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// 单生产者单消费者的定长环形队列，push/pop 均为 wait-free，不分配内存
+// Capacity 必须是 2 的幂，队列最多容纳 Capacity 个元素
+template <class T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity 必须是 2 的幂");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 生产者调用，队列满时返回 false
+    bool push(const T& value) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ >= Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ >= Capacity) {
+                return false;
+            }
+        }
+        slots_[tail & kMask] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用，队列空时返回 false
+    bool pop(T& value) {
+        const T* front = peek();
+        if (!front) {
+            return false;
+        }
+        value = *front;
+        discard();
+        return true;
+    }
+
+    // 消费者调用，返回队首元素但不取出，队列空时返回 nullptr
+    const T* peek() {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & kMask];
+    }
+
+    // 消费者调用，丢弃 peek() 返回的队首元素
+    void discard() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    std::size_t size() const {
+        return static_cast<std::size_t>(tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire));
+    }
+
+private:
+    static constexpr uint64_t kMask = Capacity - 1;
+
+    std::array<T, Capacity> slots_;
+    // 生产者
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    uint64_t head_cache_ = 0;
+    // 消费者
+    alignas(64) std::atomic<uint64_t> head_{0};
+    uint64_t tail_cache_ = 0;
+};
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "rotation.h"
+
+
+// 姿态的插值方式
+enum class OrientationInterpolation {
+    slerp,  // 路点之间球面线性插值，经过路点时角速度不连续
+    squad,  // 球面四边形插值，角速度连续
+};
+
+struct UpsamplerConfig {
+    double delay = 0.05;              // 插值时刻比当前时间滞后的时长 (秒)，应大于发送端的路点间隔
+    double max_extrapolation = 0.03;  // 路点迟到时最多外推的时长 (秒)，期间速度线性减为 0，之后保持不动
+    double min_segment = 0.005;       // 迟到路点与当前输出之间的最短插值时长 (秒)
+    OrientationInterpolation orientation = OrientationInterpolation::squad;
+};
+
+// 以下计数除 late、dropped 外均为调用 sample() 的周期数
+struct UpsamplerStats {
+    uint64_t interpolated = 0;  // 在两个路点之间插值
+    uint64_t extrapolated = 0;  // 超过最后一个路点，按末端速度外推
+    uint64_t held = 0;          // 外推时长用尽，保持不动
+    uint64_t late = 0;          // 到达时插值时刻已经超过上一个路点的路点数
+    uint64_t dropped = 0;       // 时间戳不递增或缓冲区满而丢弃的路点数
+};
+
+// 将低频的带时间戳路点插值为任意时刻的目标，供实时回调每周期调用，不分配内存
+// 位置部分为 N 维向量，段内用五次多项式，两端的位置、速度、加速度与相邻段连续；
+// with_orientation 时同时插值一个姿态四元数
+// 路点处的速度与加速度由前后两个路点的抛物线估计，后一个路点还没到时用单侧差分，加速度取 0
+// 每一段只在进入时拟合一次，之后到达的路点不会改变正在执行的段，因此输出不会跳变
+template <std::size_t N>
+class WaypointUpsampler {
+public:
+    using Vector = std::array<double, N>;
+    static constexpr std::size_t kCapacity = 16;
+
+    WaypointUpsampler(const UpsamplerConfig& config, bool with_orientation)
+        : config_(config), with_orientation_(with_orientation) {}
+
+    // 以静止于 (p, q) 的状态重新开始
+    void reset(double time, const Vector& p, const Quaternion& q = Quaternion()) {
+        tail_ = 0;
+        seg_ = 0;
+        appendKnot(time, p, q);
+        last_time_ = time - config_.delay;
+        out_p_ = p;
+        out_v_ = Vector{};
+        out_a_ = Vector{};
+        out_q_ = q;
+        fitHold();
+    }
+
+    // 加入一个路点，time 为其对应的时刻（与 sample() 的 now 同一时间轴）
+    bool push(double time, const Vector& p, const Quaternion& q = Quaternion()) {
+        const Knot& last = knot(tail_ - 1);
+        if (time <= last.time || tail_ - seg_ >= kCapacity) {
+            ++stats_.dropped;
+            return false;
+        }
+        // 与上一个路点取同一半球，保证插值走较短的一侧
+        Quaternion q_same = q;
+        if (quaternionDot(q, last.q) < 0.0) {
+            q_same = {-q.w, -q.x, -q.y, -q.z};
+        }
+
+        if (last_time_ >= last.time) {
+            // 已经在外推或保持：从当前输出重新开始一段，迟到的路点至少留出 min_segment
+            ++stats_.late;
+            if (time < last_time_ + config_.min_segment) {
+                time = last_time_ + config_.min_segment;
+            }
+            seg_ = tail_;
+            appendKnot(last_time_, out_p_, out_q_);
+            appendKnot(time, p, q_same);
+            start_p_ = out_p_;
+            start_v_ = out_v_;
+            start_a_ = out_a_;
+            start_s_ = out_q_;
+            fitSegment();
+            return true;
+        }
+
+        appendKnot(time, p, q_same);
+        if (seg_ + 2 == tail_ && seg_duration_ == 0.0) {
+            // reset() 之后的第一个路点：从静止状态开始第一段
+            start_p_ = end_p_;
+            start_v_ = end_v_;
+            start_a_ = end_a_;
+            start_s_ = end_s_;
+            fitSegment();
+        }
+        return true;
+    }
+
+    // 计算 now - delay 时刻的目标
+    void sample(double now, Vector& p, Quaternion& q) {
+        double t = now - config_.delay;
+        // 进入下一段
+        while (seg_ + 2 < tail_ && t >= knot(seg_ + 1).time) {
+            start_p_ = end_p_;
+            start_v_ = end_v_;
+            start_a_ = end_a_;
+            start_s_ = end_s_;
+            ++seg_;
+            fitSegment();
+        }
+
+        double tau = t - seg_start_;
+        if (seg_duration_ > 0.0 && tau < seg_duration_) {
+            ++stats_.interpolated;
+            evaluate(tau < 0.0 ? 0.0 : tau);
+        } else if (seg_duration_ > 0.0) {
+            extrapolate(tau - seg_duration_);
+        } else {
+            // reset() 之后还没有路点
+            ++stats_.held;
+        }
+        last_time_ = t;
+        p = out_p_;
+        q = out_q_;
+    }
+
+    // 不插值姿态时使用
+    void sample(double now, Vector& p) {
+        Quaternion q;
+        sample(now, p, q);
+    }
+
+    const UpsamplerStats& stats() const { return stats_; }
+
+    static void print(const char* name, const UpsamplerStats& s) {
+        std::cout << name << ": interpolated=" << s.interpolated << " extrapolated=" << s.extrapolated
+                  << " held=" << s.held << " late=" << s.late << " dropped=" << s.dropped << std::endl;
+    }
+
+private:
+    struct Knot {
+        double time;
+        Vector p;
+        Quaternion q;
+    };
+
+    const Knot& knot(uint64_t i) const { return knots_[i % kCapacity]; }
+
+    void appendKnot(double time, const Vector& p, const Quaternion& q) {
+        knots_[tail_ % kCapacity] = {time, p, q};
+        ++tail_;
+    }
+
+    // 初始状态：一段长度为 0 的段，之后一直保持
+    void fitHold() {
+        const Knot& k = knot(seg_);
+        seg_start_ = k.time;
+        seg_duration_ = 0.0;
+        end_p_ = k.p;
+        end_v_ = Vector{};
+        end_a_ = Vector{};
+        end_s_ = k.q;
+        seg_q0_ = k.q;
+        seg_q1_ = k.q;
+        seg_s0_ = k.q;
+        extrap_w_ = {0.0, 0.0, 0.0};
+    }
+
+    // 由 start_* 与路点 seg_+1（以及可能存在的 seg_+2）拟合当前段
+    void fitSegment() {
+        const Knot& k0 = knot(seg_);
+        const Knot& k1 = knot(seg_ + 1);
+        bool has_next = seg_ + 2 < tail_;
+        double dt1 = k1.time - k0.time;
+        seg_start_ = k0.time;
+        seg_duration_ = dt1;
+
+        // 终点的速度与加速度
+        end_p_ = k1.p;
+        for (std::size_t i = 0; i < N; ++i) {
+            double d1 = (k1.p[i] - k0.p[i]) / dt1;
+            if (has_next) {
+                const Knot& k2 = knot(seg_ + 2);
+                double dt2 = k2.time - k1.time;
+                double d2 = (k2.p[i] - k1.p[i]) / dt2;
+                end_v_[i] = (d1 * dt2 + d2 * dt1) / (dt1 + dt2);
+                end_a_[i] = 2.0 * (d2 - d1) / (dt1 + dt2);
+            } else {
+                end_v_[i] = d1;
+                end_a_[i] = 0.0;
+            }
+        }
+
+        // 五次多项式系数
+        double T = dt1, T2 = T * T, T3 = T2 * T, T4 = T3 * T, T5 = T4 * T;
+        for (std::size_t i = 0; i < N; ++i) {
+            double p0 = start_p_[i], v0 = start_v_[i], a0 = start_a_[i];
+            double p1 = end_p_[i], v1 = end_v_[i], a1 = end_a_[i];
+            auto& c = coeffs_[i];
+            c[0] = p0;
+            c[1] = v0;
+            c[2] = 0.5 * a0;
+            c[3] = (20.0 * (p1 - p0) - (8.0 * v1 + 12.0 * v0) * T - (3.0 * a0 - a1) * T2) / (2.0 * T3);
+            c[4] = (30.0 * (p0 - p1) + (14.0 * v1 + 16.0 * v0) * T + (3.0 * a0 - 2.0 * a1) * T2) / (2.0 * T4);
+            c[5] = (12.0 * (p1 - p0) - 6.0 * (v1 + v0) * T - (a0 - a1) * T2) / (2.0 * T5);
+        }
+
+        if (with_orientation_) {
+            seg_q0_ = k0.q;
+            seg_q1_ = k1.q;
+            seg_s0_ = start_s_;
+            if (config_.orientation == OrientationInterpolation::squad && has_next) {
+                end_s_ = squadControlPoint(k0.q, k1.q, knot(seg_ + 2).q);
+            } else {
+                end_s_ = k1.q;
+            }
+            // 外推用的角速度（基坐标系）取最后一段的平均值
+            std::array<double, 3> r = quaternionToRotationVector(quaternionMultiply(k1.q, quaternionConjugate(k0.q)));
+            for (int i = 0; i < 3; ++i) {
+                extrap_w_[i] = r[i] / dt1;
+            }
+        }
+    }
+
+    void evaluate(double tau) {
+        for (std::size_t i = 0; i < N; ++i) {
+            const auto& c = coeffs_[i];
+            out_p_[i] = c[0] + tau * (c[1] + tau * (c[2] + tau * (c[3] + tau * (c[4] + tau * c[5]))));
+            out_v_[i] = c[1] + tau * (2.0 * c[2] + tau * (3.0 * c[3] + tau * (4.0 * c[4] + tau * 5.0 * c[5])));
+            out_a_[i] = 2.0 * c[2] + tau * (6.0 * c[3] + tau * (12.0 * c[4] + tau * 20.0 * c[5]));
+        }
+        if (with_orientation_) {
+            double h = tau / seg_duration_;
+            if (config_.orientation == OrientationInterpolation::squad) {
+                out_q_ = quaternionSquad(seg_q0_, seg_q1_, seg_s0_, end_s_, h);
+            } else {
+                out_q_ = quaternionSlerp(seg_q0_, seg_q1_, h);
+            }
+        }
+    }
+
+    // 超过最后一个路点 over 秒：速度在 max_extrapolation 内线性减为 0，位移为 v * (over - over^2 / 2E)
+    void extrapolate(double over) {
+        double E = config_.max_extrapolation;
+        double scale, speed;
+        if (E > 0.0 && over < E) {
+            ++stats_.extrapolated;
+            scale = over - over * over / (2.0 * E);
+            speed = 1.0 - over / E;
+        } else {
+            ++stats_.held;
+            scale = 0.5 * E;
+            speed = 0.0;
+        }
+        for (std::size_t i = 0; i < N; ++i) {
+            out_p_[i] = end_p_[i] + end_v_[i] * scale;
+            out_v_[i] = end_v_[i] * speed;
+            out_a_[i] = speed > 0.0 ? -end_v_[i] / E : 0.0;
+        }
+        if (with_orientation_) {
+            out_q_ = quaternionMultiply(
+                quaternionFromRotationVector({extrap_w_[0] * scale, extrap_w_[1] * scale, extrap_w_[2] * scale}), seg_q1_);
+        }
+    }
+
+    UpsamplerConfig config_;
+    bool with_orientation_;
+    UpsamplerStats stats_;
+
+    std::array<Knot, kCapacity> knots_;  // 环形缓冲区，只保留当前段起点及之后的路点
+    uint64_t tail_ = 0;
+    uint64_t seg_ = 0;       // 当前段的起点路点
+    double last_time_ = 0.0;  // 上一次插值的时刻
+
+    // 当前段
+    double seg_start_ = 0.0;
+    double seg_duration_ = 0.0;
+    std::array<std::array<double, 6>, N> coeffs_ = {};
+    Vector start_p_ = {}, start_v_ = {}, start_a_ = {};
+    Vector end_p_ = {}, end_v_ = {}, end_a_ = {};
+    Quaternion seg_q0_, seg_q1_, seg_s0_, start_s_, end_s_;
+    std::array<double, 3> extrap_w_ = {0.0, 0.0, 0.0};
+
+    // 上一次的输出
+    Vector out_p_ = {}, out_v_ = {}, out_a_ = {};
+    Quaternion out_q_;
+};
+
+// 行主序 4x4 变换矩阵与 (位置, 四元数) 之间的转换
+inline void poseFromMatrix(const std::array<double, 16>& T, std::array<double, 3>& p, Quaternion& q) {
+    p = {T[3], T[7], T[11]};
+    q = quaternionFromMatrix(T);
+}
+
+inline void poseToMatrix(const std::array<double, 3>& p, const Quaternion& q, std::array<double, 16>& T) {
+    quaternionToMatrix(q, T);
+    T[3] = p[0];
+    T[7] = p[1];
+    T[11] = p[2];
+    T[12] = 0.0;
+    T[13] = 0.0;
+    T[14] = 0.0;
+    T[15] = 1.0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+
+// 逐轴限制加速度与加加速度的在线速度轨迹生成器
+// 每个周期向目标速度靠近一步：选择本周期的加速度 a，使之后以最大加加速度把 a 减为 0 时恰好到达目标速度，
+// 即 a * dt + a|a| / (2J) = v_target - v，再按 [-A, A] 和 [a_prev - J dt, a_prev + J dt] 截断
+// 离目标很近时 a 趋于 (v_target - v) / dt，一步收敛，不会在目标附近来回振荡
+template <std::size_t N>
+class VelocityOtg {
+public:
+    using Vector = std::array<double, N>;
+
+    VelocityOtg(const Vector& max_acceleration, const Vector& max_jerk)
+        : max_acceleration_(max_acceleration), max_jerk_(max_jerk) {}
+
+    void reset(const Vector& velocity = Vector{}) {
+        velocity_ = velocity;
+        acceleration_ = Vector{};
+    }
+
+    // 目标速度可以任意跳变，返回本周期的输出速度
+    const Vector& update(const Vector& target, double dt) {
+        bool limited = false;
+        for (std::size_t i = 0; i < N; ++i) {
+            double A = max_acceleration_[i];
+            double J = max_jerk_[i];
+            double dv = target[i] - velocity_[i];
+            double a = std::copysign(J * (std::sqrt(dt * dt + 2.0 * std::fabs(dv) / J) - dt), dv);
+            a = std::fmax(-A, std::fmin(A, a));
+            double a_prev = acceleration_[i];
+            a = std::fmax(a_prev - J * dt, std::fmin(a_prev + J * dt, a));
+            velocity_[i] += a * dt;
+            acceleration_[i] = a;
+            if (std::fabs(target[i] - velocity_[i]) > 1e-9) {
+                limited = true;
+            }
+        }
+        ++cycles_;
+        if (limited) {
+            ++limited_;
+        }
+        return velocity_;
+    }
+
+    const Vector& velocity() const { return velocity_; }
+    const Vector& acceleration() const { return acceleration_; }
+
+    // 输出速度没有跟上目标速度的周期数
+    uint64_t limited() const { return limited_; }
+
+    void print(const char* name) const {
+        std::cout << name << ": cycles=" << cycles_ << " limited=" << limited_ << std::endl;
+    }
+
+private:
+    Vector max_acceleration_;
+    Vector max_jerk_;
+    Vector velocity_ = {};
+    Vector acceleration_ = {};
+    uint64_t cycles_ = 0;
+    uint64_t limited_ = 0;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+
+// 指令速度与实际速度的对比结果，线速度单位 m/s，角速度单位 rad/s
+struct VelocityTrackingSummary {
+    uint64_t samples = 0;
+    double linear_rms_error = 0.0;
+    double angular_rms_error = 0.0;
+    double linear_ratio = 0.0;    // 指令方向上实际速度与指令速度之比的均值，只统计指令速度足够大的周期
+    double angular_ratio = 0.0;
+    double linear_max_error = 0.0;
+    double angular_max_error = 0.0;
+};
+
+// 由实际 tcp 位姿差分得到实际速度，与基坐标系下的指令速度比较
+// 实际速度经过一阶低通滤波，以减小状态量化噪声的影响
+class VelocityTracker {
+public:
+    explicit VelocityTracker(double filter_alpha = 0.1, double min_linear = 1e-3, double min_angular = 1e-3)
+        : alpha_(filter_alpha), min_linear_(min_linear), min_angular_(min_angular) {}
+
+    // commanded_* 为本周期在基坐标系下的指令速度，tcp_in_base 为本周期测得的 tcp 位姿，dt 为与上一周期的间隔
+    void update(const std::array<double, 3>& commanded_linear, const std::array<double, 3>& commanded_angular,
+                const std::array<double, 16>& tcp_in_base, double dt) {
+        if (has_last_ && dt > 0.0) {
+            std::array<double, 3> linear, angular;
+            for (int i = 0; i < 3; ++i) {
+                linear[i] = (tcp_in_base[i * 4 + 3] - last_[i * 4 + 3]) / dt;
+            }
+            rotationDelta(last_, tcp_in_base, angular);
+            for (int i = 0; i < 3; ++i) {
+                angular[i] /= dt;
+                linear_filtered_[i] += alpha_ * (linear[i] - linear_filtered_[i]);
+                angular_filtered_[i] += alpha_ * (angular[i] - angular_filtered_[i]);
+            }
+            accumulate(commanded_linear, linear_filtered_, min_linear_, linear_sq_error_, linear_max_error_,
+                       linear_ratio_sum_, linear_ratio_count_);
+            accumulate(commanded_angular, angular_filtered_, min_angular_, angular_sq_error_, angular_max_error_,
+                       angular_ratio_sum_, angular_ratio_count_);
+            ++samples_;
+        }
+        last_ = tcp_in_base;
+        has_last_ = true;
+    }
+
+    // 控制循环暂停后重新开始，不对暂停前后的位姿做差分，已有的统计保留
+    void restart() { has_last_ = false; }
+
+    VelocityTrackingSummary summary() const {
+        VelocityTrackingSummary s;
+        s.samples = samples_;
+        if (samples_ > 0) {
+            s.linear_rms_error = std::sqrt(linear_sq_error_ / samples_);
+            s.angular_rms_error = std::sqrt(angular_sq_error_ / samples_);
+        }
+        s.linear_ratio = linear_ratio_count_ > 0 ? linear_ratio_sum_ / linear_ratio_count_ : 0.0;
+        s.angular_ratio = angular_ratio_count_ > 0 ? angular_ratio_sum_ / angular_ratio_count_ : 0.0;
+        s.linear_max_error = linear_max_error_;
+        s.angular_max_error = angular_max_error_;
+        return s;
+    }
+
+    static void print(const char* name, const VelocityTrackingSummary& s) {
+        std::cout << name << ": n=" << s.samples
+                  << " linear rms=" << s.linear_rms_error << "m/s max=" << s.linear_max_error << "m/s ratio=" << s.linear_ratio
+                  << " angular rms=" << s.angular_rms_error << "rad/s max=" << s.angular_max_error << "rad/s ratio=" << s.angular_ratio
+                  << std::endl;
+    }
+
+private:
+    // 旋转增量 R_now * R_last^T 的旋转向量（基坐标系）
+    static void rotationDelta(const std::array<double, 16>& last, const std::array<double, 16>& now, std::array<double, 3>& rotvec) {
+        double d[3][3];
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                d[i][j] = 0.0;
+                for (int k = 0; k < 3; ++k) {
+                    d[i][j] += now[i * 4 + k] * last[j * 4 + k];
+                }
+            }
+        }
+        double cos_angle = (d[0][0] + d[1][1] + d[2][2] - 1.0) * 0.5;
+        cos_angle = std::fmax(-1.0, std::fmin(1.0, cos_angle));
+        double angle = std::acos(cos_angle);
+        double sin_angle = std::sin(angle);
+        // 小角度时 angle / (2 sin(angle)) 趋于 1/2
+        double scale = sin_angle > 1e-9 ? angle / (2.0 * sin_angle) : 0.5;
+        rotvec = {(d[2][1] - d[1][2]) * scale, (d[0][2] - d[2][0]) * scale, (d[1][0] - d[0][1]) * scale};
+    }
+
+    static void accumulate(const std::array<double, 3>& commanded, const std::array<double, 3>& actual, double min_norm,
+                           double& sq_error, double& max_error, double& ratio_sum, uint64_t& ratio_count) {
+        double err2 = 0.0, cmd2 = 0.0, dot = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double e = actual[i] - commanded[i];
+            err2 += e * e;
+            cmd2 += commanded[i] * commanded[i];
+            dot += actual[i] * commanded[i];
+        }
+        sq_error += err2;
+        double err = std::sqrt(err2);
+        if (err > max_error) {
+            max_error = err;
+        }
+        if (cmd2 > min_norm * min_norm) {
+            ratio_sum += dot / cmd2;
+            ++ratio_count;
+        }
+    }
+
+    double alpha_;
+    double min_linear_;
+    double min_angular_;
+    bool has_last_ = false;
+    std::array<double, 16> last_ = {0.0};
+    std::array<double, 3> linear_filtered_ = {0.0};
+    std::array<double, 3> angular_filtered_ = {0.0};
+    uint64_t samples_ = 0;
+    double linear_sq_error_ = 0.0;
+    double angular_sq_error_ = 0.0;
+    double linear_max_error_ = 0.0;
+    double angular_max_error_ = 0.0;
+    double linear_ratio_sum_ = 0.0;
+    double angular_ratio_sum_ = 0.0;
+    uint64_t linear_ratio_count_ = 0;
+    uint64_t angular_ratio_count_ = 0;
+};
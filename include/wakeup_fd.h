@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+// 用 eventfd 唤醒阻塞在 zmq_poll/epoll 上的线程，例如通知接收线程退出
+// notify() 可以在任意线程调用，多次通知在 drain() 前合并为一次
+class WakeupFd {
+public:
+    WakeupFd() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+    ~WakeupFd() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    WakeupFd(const WakeupFd&) = delete;
+    WakeupFd& operator=(const WakeupFd&) = delete;
+
+    int fd() const { return fd_; }
+    bool valid() const { return fd_ >= 0; }
+
+    void notify() {
+        uint64_t one = 1;
+        while (write(fd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+
+    // 清除已有的通知，等待线程被唤醒后调用
+    void drain() {
+        uint64_t value;
+        while (read(fd_, &value, sizeof(value)) < 0 && errno == EINTR) {
+        }
+    }
+
+private:
+    int fd_;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+// 命令消息的二进制格式（小端，与 scripts/wire_format.py 一致），JSON 消息仍然可用，以首 4 字节是否为 kWireMagic 区分
+// [64 字节 WireHeader][steps * values_per_step 个数值，float64 或 float32（flags 含 kWireFloat32）]
+// 版本号不同的消息直接拒绝，新增字段时增加版本号
+constexpr uint32_t kWireMagic = 0x4D434B52;  // "RKCM"
+constexpr uint8_t kWireVersion = 1;
+
+enum class WireType : uint8_t {
+    none = 0,                // 没有机械臂命令，只有夹爪速度等附加字段
+    cartesian_velocity = 1,  // 6 个值
+    pose_matrix = 2,         // 16 个值，行主序
+    joint_position = 3,      // 7 个值
+    joint_velocity = 4,      // 7 个值
+    joint_chunk = 5,         // steps × 7
+    pose_chunk = 6,          // steps × 16
+};
+
+enum WireFlags : uint8_t {
+    kWireFloat32 = 1,   // 负载为 float32，否则为 float64
+    kWireSentTime = 2,  // sent_time 有效
+    kWireExecTime = 4,  // exec_time 有效
+    kWireGripper = 8,   // gripper_velocity 有效
+};
+
+struct WireHeader {
+    uint32_t magic = kWireMagic;
+    uint8_t version = kWireVersion;
+    uint8_t type = 0;
+    uint8_t flags = 0;
+    uint8_t reserved = 0;
+    uint32_t steps = 1;            // 动作块的步数，其它类型为 1
+    uint32_t values_per_step = 0;  // 每步的数值个数，必须与类型一致
+    uint64_t seq = 0;              // 发送端的序号
+    double sent_time = 0.0;        // 发送端时钟 (秒)
+    double exec_time = 0.0;        // 计划执行时间，发送端时钟 (秒)
+    double chunk_start = 0.0;      // 动作块第一步的执行时刻，与发布的 Timestamp 同一时钟，0 表示接收时刻
+    double chunk_period = 0.0;     // 动作块相邻两步的间隔 (秒)
+    double gripper_velocity = 0.0;
+};
+static_assert(sizeof(WireHeader) == 64, "WireHeader 的布局必须与 wire_format.py 一致");
+
+// 各类型每步的数值个数
+constexpr uint32_t wireValuesPerStep(WireType type) {
+    switch (type) {
+        case WireType::none: return 0;
+        case WireType::cartesian_velocity: return 6;
+        case WireType::pose_matrix: return 16;
+        case WireType::joint_position: return 7;
+        case WireType::joint_velocity: return 7;
+        case WireType::joint_chunk: return 7;
+        case WireType::pose_chunk: return 16;
+    }
+    return 0;
+}
+
+inline bool isWireMessage(const void* data, std::size_t size) {
+    uint32_t magic;
+    if (size < sizeof(magic)) {
+        return false;
+    }
+    std::memcpy(&magic, data, sizeof(magic));
+    return magic == kWireMagic;
+}
+
+enum class WireStatus {
+    ok,
+    not_wire,     // 不是二进制消息（例如 JSON）
+    bad_version,
+    bad_type,
+    bad_size,
+    bad_value,    // 头或负载中有 NaN、无穷大
+};
+
+inline const char* wireStatusName(WireStatus status) {
+    switch (status) {
+        case WireStatus::ok: return "ok";
+        case WireStatus::not_wire: return "not_wire";
+        case WireStatus::bad_version: return "bad_version";
+        case WireStatus::bad_type: return "bad_type";
+        case WireStatus::bad_size: return "bad_size";
+        case WireStatus::bad_value: return "bad_value";
+    }
+    return "unknown";
+}
+
+// 在消息内存上直接解码，只拷贝 64 字节的头；消息内存不保证对齐，数值用 memcpy 读取
+// parse 检查头与负载中的所有数值都是有限值，之后的 value 与 step 不再检查
+// 视图只在消息内存有效期间可用
+class WireView {
+public:
+    WireStatus parse(const void* data, std::size_t size) {
+        if (!isWireMessage(data, size)) {
+            return WireStatus::not_wire;
+        }
+        if (size < sizeof(WireHeader)) {
+            return WireStatus::bad_size;
+        }
+        std::memcpy(&header_, data, sizeof(WireHeader));
+        if (header_.version != kWireVersion) {
+            return WireStatus::bad_version;
+        }
+        if (header_.type > static_cast<uint8_t>(WireType::pose_chunk) ||
+            header_.values_per_step != wireValuesPerStep(type())) {
+            return WireStatus::bad_type;
+        }
+        bool chunk = type() == WireType::joint_chunk || type() == WireType::pose_chunk;
+        if (!chunk && header_.steps != 1) {
+            return WireStatus::bad_type;
+        }
+        value_size_ = (header_.flags & kWireFloat32) ? sizeof(float) : sizeof(double);
+        std::size_t payload = static_cast<std::size_t>(header_.steps) * header_.values_per_step * value_size_;
+        if (size != sizeof(WireHeader) + payload) {
+            return WireStatus::bad_size;
+        }
+        payload_ = static_cast<const unsigned char*>(data) + sizeof(WireHeader);
+        // 未使用的字段按格式为 0，一并检查
+        if (!std::isfinite(header_.sent_time) || !std::isfinite(header_.exec_time) ||
+            !std::isfinite(header_.chunk_start) || !std::isfinite(header_.chunk_period) ||
+            !std::isfinite(header_.gripper_velocity)) {
+            return WireStatus::bad_value;
+        }
+        std::size_t count = static_cast<std::size_t>(header_.steps) * header_.values_per_step;
+        bool finite = value_size_ == sizeof(float) ? allFinite<uint32_t>(payload_, count, 0x7F800000u)
+                                                   : allFinite<uint64_t>(payload_, count, 0x7FF0000000000000ull);
+        return finite ? WireStatus::ok : WireStatus::bad_value;
+    }
+
+    const WireHeader& header() const { return header_; }
+    WireType type() const { return static_cast<WireType>(header_.type); }
+    uint32_t steps() const { return header_.steps; }
+    bool hasSentTime() const { return header_.flags & kWireSentTime; }
+    bool hasExecTime() const { return header_.flags & kWireExecTime; }
+    bool hasGripper() const { return header_.flags & kWireGripper; }
+
+    // 负载中的第 i 个数值
+    double value(std::size_t i) const {
+        if (value_size_ == sizeof(float)) {
+            float v;
+            std::memcpy(&v, payload_ + i * sizeof(float), sizeof(float));
+            return v;
+        }
+        double v;
+        std::memcpy(&v, payload_ + i * sizeof(double), sizeof(double));
+        return v;
+    }
+
+    // 第 step 步的 N 个数值，N 必须等于 values_per_step
+    template <std::size_t N>
+    void step(std::size_t step, std::array<double, N>& out) const {
+        std::size_t offset = step * N;
+        if (value_size_ == sizeof(double)) {
+            std::memcpy(out.data(), payload_ + offset * sizeof(double), N * sizeof(double));
+        } else {
+            for (std::size_t i = 0; i < N; ++i) {
+                out[i] = value(offset + i);
+            }
+        }
+    }
+
+private:
+    // 指数位全为 1 的是 NaN 或无穷大，按位检查整段负载，不提前退出以便向量化
+    template <class Bits>
+    static bool allFinite(const unsigned char* payload, std::size_t count, Bits exponent) {
+        bool finite = true;
+        for (std::size_t i = 0; i < count; ++i) {
+            Bits bits;
+            std::memcpy(&bits, payload + i * sizeof(Bits), sizeof(Bits));
+            finite &= (bits & exponent) != exponent;
+        }
+        return finite;
+    }
+
+    WireHeader header_;
+    const unsigned char* payload_ = nullptr;
+    std::size_t value_size_ = sizeof(double);
+};
+
+// 编码一条消息，values 为 steps * values_per_step 个数值，用于测试与 C++ 发送端
+inline void encodeWire(const WireHeader& header, const double* values, std::vector<unsigned char>& out) {
+    bool f32 = header.flags & kWireFloat32;
+    std::size_t count = static_cast<std::size_t>(header.steps) * header.values_per_step;
+    out.resize(sizeof(WireHeader) + count * (f32 ? sizeof(float) : sizeof(double)));
+    std::memcpy(out.data(), &header, sizeof(WireHeader));
+    unsigned char* payload = out.data() + sizeof(WireHeader);
+    if (f32) {
+        for (std::size_t i = 0; i < count; ++i) {
+            float v = static_cast<float>(values[i]);
+            std::memcpy(payload + i * sizeof(float), &v, sizeof(float));
+        }
+    } else if (count > 0) {
+        std::memcpy(payload, values, count * sizeof(double));
+    }
+}
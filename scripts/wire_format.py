@@ -0,0 +1,59 @@
+import math
+import struct
+
+# 与 include/wire_format.h 一致的二进制命令格式，all_control 以首 4 字节区分二进制与 JSON 消息
+# 用法: socket.send(encode("joint_chunk", actions, sent_time=time.monotonic(), chunk_period=0.01))
+
+WIRE_MAGIC = 0x4D434B52  # "RKCM"
+WIRE_VERSION = 1
+
+# 类型编号与每步的数值个数
+WIRE_TYPES = {
+    "none": (0, 0),
+    "cartesian_velocity": (1, 6),
+    "pose_matrix": (2, 16),
+    "joint_position": (3, 7),
+    "joint_velocity": (4, 7),
+    "joint_chunk": (5, 7),
+    "pose_chunk": (6, 16),
+}
+
+FLOAT32 = 1
+SENT_TIME = 2
+EXEC_TIME = 4
+GRIPPER = 8
+
+# magic, version, type, flags, reserved, steps, values_per_step, seq,
+# sent_time, exec_time, chunk_start, chunk_period, gripper_velocity
+HEADER = struct.Struct("<IBBBBIIQddddd")
+assert HEADER.size == 64
+
+
+def encode(kind, values=(), seq=0, sent_time=None, exec_time=None, chunk_start=0.0, chunk_period=0.0,
+           gripper_velocity=None, float32=False):
+    """kind 为 WIRE_TYPES 中的名字；动作块的 values 为每步一个列表，其它类型为一个列表，位姿矩阵为行主序 16 个数"""
+    type_id, per_step = WIRE_TYPES[kind]
+    chunk = kind.endswith("_chunk")
+    if chunk:
+        rows = [list(v) for v in values]
+    elif per_step > 0:
+        rows = [list(values)]
+    else:
+        rows = []
+    flat = [float(x) for row in rows for x in row]
+    if any(len(row) != per_step for row in rows):
+        raise ValueError("%s 每步需要 %d 个数值" % (kind, per_step))
+    times = [sent_time or 0.0, exec_time or 0.0, chunk_start, chunk_period, gripper_velocity or 0.0]
+    if not all(math.isfinite(x) for x in flat + times):
+        raise ValueError("%s 含有 NaN 或无穷大，all_control 会拒绝 (bad_value)" % kind)
+
+    flags = FLOAT32 if float32 else 0
+    if sent_time is not None:
+        flags |= SENT_TIME
+    if exec_time is not None:
+        flags |= EXEC_TIME
+    if gripper_velocity is not None:
+        flags |= GRIPPER
+    header = HEADER.pack(WIRE_MAGIC, WIRE_VERSION, type_id, flags, 0, len(rows) if chunk else 1, per_step, seq,
+                         sent_time or 0.0, exec_time or 0.0, chunk_start, chunk_period, gripper_velocity or 0.0)
+    return header + struct.pack("<%d%s" % (len(flat), "f" if float32 else "d"), *flat)
@@ -6,94 +6,146 @@
 #include <array>
 #include <chrono>
 #include <string>
+#include <algorithm>
 #include <zmq.hpp>
 #include "json.hpp"
 #include "rokae/robot.h"
 #include "rokae/utility.h"
 #include "dh_gripper_factory.h"
+#include "command.h"
+#include "pose_utils.h"
+#include "rt_state.h"
+#include "seqlock.h"
+#include "rt_alloc_guard.h"
+#include "rt_thread.h"
+#include "latency_histogram.h"
+#include "async_logger.h"
+#include "cycle_dt.h"
+#include "velocity_tracking.h"
+#include "rotation.h"
+#include "spsc_queue.h"
+#include "upsampler.h"
+#include "action_chunk.h"
+#include "playout.h"
+#include "velocity_otg.h"
+#include "kinematics.h"
+#include "ik_service.h"
+#include "safety_filter.h"
+#include "wakeup_fd.h"
+#include "wire_format.h"
+#include "json_command.h"
+#include "json_arena.h"
 
 using json = nlohmann::json;
 
 // #define DEBUG
 
 
-template <std::size_t N>
-void multiplyMatrices(const std::array<double, N * N>& A, const std::array<double, N * N>& B, std::array<double, N * N>& result) {
-    for (std::size_t i = 0; i < N; ++i) {
-        for (std::size_t j = 0; j < N; ++j) {
-            result[i * N + j] = 0;
-            for (std::size_t k = 0; k < N; ++k) {
-                result[i * N + j] += A[i * N + k] * B[k * N + j];
-            }
-        }
-    }
-}
-
-void extractXYZRPY(const std::array<double, 16>& transform, std::array<double, 6>& xyzrpy) {
-    xyzrpy[0] = transform[3];  // X
-    xyzrpy[1] = transform[7];  // Y
-    xyzrpy[2] = transform[11]; // Z
-
-    double r00 = transform[0];
-    double r01 = transform[1];
-    double r10 = transform[4];
-    double r11 = transform[5];
-    double r20 = transform[8];
-    double r21 = transform[9];
-    double r22 = transform[10];
-
-    double pitch = std::asin(-r20);
-    double cos_pitch = std::cos(pitch);
-
-    const double EPSILON = 1e-6;
-
-    double roll, yaw;
-
-    if (std::abs(cos_pitch) > EPSILON) {
-        roll = std::atan2(r21, r22);
-        yaw = std::atan2(r10, r00);
-    } else {
-        // Gimbal lock
-        roll = 0.0;
-        if (pitch < 0) {
-            yaw = std::atan2(-r01, r11);
-        } else {
-            yaw = std::atan2(r01, r11);
-        }
-    }
-
-    xyzrpy[3] = roll;
-    xyzrpy[4] = pitch;
-    xyzrpy[5] = yaw;
+// 延迟直方图的百分位，单位微秒，逐个键赋值，不构造临时的 json 对象
+template <class Json>
+void latencyToJson(const LatencyHistogram& hist, Json& out) {
+    out["n"] = hist.count();
+    out["p50"] = hist.percentile(0.5) * 1e-3;
+    out["p99"] = hist.percentile(0.99) * 1e-3;
+    out["p99.9"] = hist.percentile(0.999) * 1e-3;
+    out["max"] = hist.max() * 1e-3;
 }
 
 
-enum class CmdType {
-    xyzrpy_vel, // 接收笛卡尔速度
-    joint_pose, // 接收关节角度（期望接收频率接近1000Hz，否则会运动不平滑）
-    pose_mat,   // 接收tcp变换矩阵（期望接收频率接近1000Hz，否则会运动不平滑）
-};
-
-
 int main() {
     std::cout.setf(std::ios::showpoint);
     std::cout.precision(4);
+    // 实时回调中的日志只入队，由后台线程格式化输出
+    AsyncLogger logger;
+    logger.start();
     const bool logging = false;
     const char* zmq_recv_addr = "tcp://localhost:5555";
     const char* zmq_pub_addr = "tcp://localhost:5556";
 
     // 使用位置控制模式，否则为阻抗控制（阻抗控制需要不装工具或有工具标定数据，后者暂时没有）
     const bool usePositionControl = true;
-    // （仅在xyzrpy_vel时有效）使用期望的当前位置，否则为实时查询到的，此时由于传给机械臂的位置差总是很小动作会很慢，需要增大最大速度
+    // （仅在xyzrpy_vel与xyzrpy_vel_ik时有效）使用期望的当前位置，否则为实时查询到的，此时由于传给机械臂的位置差总是很小动作会很慢，需要增大最大速度
     const bool useDesiredPose = true;
-    // （仅在xyzrpy_vel时有效）解释命令为相对于工具坐标系的移动，否则相对于基座标系
+    // （仅在xyzrpy_vel与xyzrpy_vel_ik时有效）解释命令为相对于工具坐标系的移动，否则相对于基座标系
     const bool useTCPMove = true;
+    // （仅在xyzrpy_vel、xyzrpy_vel_ik与joint_vel时有效）积分步长：fixed 固定为 1ms，measured 由控制周期时间戳计算并计入丢失的周期
+    const IntegratorDt integratorDt = IntegratorDt::measured;
+    // 在回调中使用控制器每周期推送的状态数据（getStateData），否则每周期调用 robot.posture()/jointPos() 查询
+    const bool useStateDataInLoop = true;
+    // 由关节角度用解析正运动学计算法兰位姿，代替 tcpPose_m 或 robot.posture()；启动时与 SDK 位姿比对，误差超出容差时仍使用 SDK 位姿
+    // 运行中每 fk_check_interval 个周期读取一次 tcpPose_m 继续比对（仅 useStateDataInLoop 时），超出容差时改回 SDK 位姿，
+    // 同时停用依赖运动学模型的奇异位形缩放、xyzrpy_vel_ik 与可达性检查
+    const bool useAnalyticFk = true;
+    const double fk_position_tolerance = 1e-4;  // 米
+    const double fk_rotation_tolerance = 1e-3;  // 弧度
+    const uint64_t fk_check_interval = 1000;
+    // 启动时依次移动到这些位形比对（之后回到初始位置），各关节都不为零，关节轴方向或零位的错误在关节角为 0 时看不出来
+    const std::array<std::array<double, 7>, 3> fk_check_poses = {{
+        {0.20, M_PI / 6 + 0.10, -0.25, M_PI / 3 + 0.15, 0.30, M_PI / 2 - 0.20, 0.35},
+        {-0.25, M_PI / 6 - 0.10, 0.20, M_PI / 3 - 0.10, -0.30, M_PI / 2 + 0.15, -0.40},
+        {0.15, M_PI / 6 + 0.20, 0.30, M_PI / 3 + 0.25, -0.20, M_PI / 2 - 0.10, 0.45},
+    }};
 
     const CmdType cmdType = CmdType::xyzrpy_vel;
-
-    // xyzrpy_vel时的最大速度，假设期望速度在 [-1, 1] 范围内进行归一化
+    // 以上为启动时的控制模式，运行中可以发送 {"mode": "pose_mat", "position_control": true, "desired_pose": true, "tcp_move": true}
+    // 切换（除 mode 外的字段可省略，省略时保持上一次请求的值），切换时停止控制循环，从当前位置无扰地重新启动
+    // 当前的控制模式，只在控制循环停止时由主线程修改
+    ControlMode mode = {cmdType, usePositionControl, useDesiredPose, useTCPMove};
+    std::atomic<CmdType> active_cmd_type{cmdType};  // 供 zmq 线程读取
+
+    // （仅在pose_mat与joint_pose时有效）将低频路点插值为每周期的目标（关节与位置用五次样条，姿态用SQUAD），否则直接使用最近一条命令
+    const bool useUpsampling = true;
+    // 路点按计划执行时间插值，滞后由 playout_delay 提供（没有时间戳的路点按接收时间加 playout_delay）；路点迟到时最多外推 30ms
+    const UpsamplerConfig upsampler_config = {0.0, 0.03, 0.005, OrientationInterpolation::squad};
+    // （仅在joint_chunk与pose_chunk时有效）重叠动作块的指数时间集成，偏向较早的动作块，动作块加入和结束时淡入淡出 20ms
+    const EnsembleConfig ensemble_config = {-0.5, 0.02};
+
+    // xyzrpy_vel时的最大速度，假设期望速度在 [-1, 1] 范围内进行归一化；也是 pose_mat 与 pose_chunk 接近奇异位形时缩放的基准
     const double max_linear_velocity = 0.06;   // 最大线速度 (米/秒)
     const double max_angular_velocity = 0.10;  // 最大角速度 (弧度/秒)
+    // joint_vel时各关节的最大速度，期望速度同样在 [-1, 1] 范围内归一化，以及各关节的最大加速度与加加速度
+    const std::array<double, 7> max_joint_velocity = {0.3, 0.3, 0.3, 0.3, 0.5, 0.5, 0.5};          // 弧度/秒
+    const std::array<double, 7> max_joint_acceleration = {1.0, 1.0, 1.0, 1.0, 2.0, 2.0, 2.0};      // 弧度/秒^2
+    const std::array<double, 7> max_joint_jerk = {10.0, 10.0, 10.0, 10.0, 20.0, 20.0, 20.0};       // 弧度/秒^3
+    // xyzrpy_vel_ik 时由阻尼最小二乘求关节速度（同样受 max_joint_velocity 限制），接近奇异位形时增大阻尼；
+    // 冗余的第 7 自由度用于把关节拉回偏好姿态（启动或切换模式时的关节角度，主要决定肘部位置），nullspace_gain 单位为 1/秒
+    const DlsConfig dls_config = {0.05, 0.02};
+    const double nullspace_gain = 1.0;
+
+    // xyzrpy_vel与joint_vel时对期望速度逐轴限制加速度与加加速度，速度阶跃和超时停止都会平滑过渡，否则直接使用期望速度
+    const bool useVelocityOtg = true;
+    const std::array<double, 6> max_twist_acceleration = {0.5, 0.5, 0.5, 1.0, 1.0, 1.0};  // 米/秒^2，弧度/秒^2
+    const std::array<double, 6> max_twist_jerk = {5.0, 5.0, 5.0, 10.0, 10.0, 10.0};      // 米/秒^3，弧度/秒^3
+
+    // （仅在pose_mat、pose_chunk与xyzrpy_vel时有效）按实际关节角度每周期计算雅可比矩阵与可操作度 sqrt(det(J J^T))，
+    // 接近奇异位形时平滑地缩小笛卡尔速度，pose_mat 与 pose_chunk 时每周期的位移与转角不超过缩放后的 max_linear_velocity、max_angular_velocity；
+    // 可操作度在 {threshold, minimum} 之间从 1 降到 min_scale
+    const bool useSingularityScaling = true;
+    const SingularityScalingConfig singularity_scaling = {0.02, 0.002, 0.1};
+
+    // （仅在pose_mat与pose_chunk时有效）zmq_receiver 用逆运动学检查每个目标位姿（及动作块的每一步）是否可达，不在实时线程上运行
+    // 每个目标只从上一个目标的解迭代（动作块逐步接续），动作块在第一个不收敛的步停止检查，每条消息最多一次不收敛的迭代，耗时有上限；
+    // 不收敛的目标交给后台线程在 ik_threads 个工作线程上并行尝试其余初值，后台搜索最多每 ik_search_interval 开始一次，
+    // 搜索完成前目标原样通过。搜索确认不可达后，再不收敛的目标及动作块其后的步在 clampUnreachable 时换成误差最小的位姿
+    // （否则只计数告警），直到目标重新可达。运动学模型未通过比对时不检查
+    const bool useReachabilityCheck = true;
+    const bool clampUnreachable = true;
+    const IkConfig ik_config = {32, 60, 1e-4, 1e-3, 0.3, {0.05, 0.02}};
+    const std::size_t ik_threads = 3;
+    const std::chrono::milliseconds ik_search_interval(20);
+
+    // 实时回调返回前的安全限制：tcp 目标位置限制在工作空间（半空间的交集）内，关节目标限制在软限位内，并限制每周期的步长
+    // 笛卡尔空间的模式检查工作空间与 tcp 步长，轴空间的模式检查软限位与关节步长，运动学模型通过比对时由正运动学同样检查工作空间；
+    // 位置在工作空间外时（启动或切换模式时）只允许向工作空间内运动；每次生效都计数并发布
+    const bool useSafetyFilter = true;
+    constexpr std::array<Halfspace, 6> safety_workspace = boxHalfspaces({0.25, -0.55, 0.05}, {0.95, 0.55, 1.0});  // 米
+    const SafetyLimits safety_limits = {
+        5e-4,  // tcp 每周期最大位移 (米)
+        1e-3,  // tcp 每周期最大转角 (弧度)
+        {-2.90, -2.04, -2.90, -2.04, -2.90, -2.04, -6.20},  // 关节软限位 (弧度)，比 XMateEr7Pro 的限位小约 0.05
+        {2.90, 2.04, 2.90, 2.04, 2.90, 2.04, 6.20},
+        {2.5e-3, 2.5e-3, 2.5e-3, 2.5e-3, 3.0e-3, 3.0e-3, 3.0e-3},  // 每周期各关节最大变化 (弧度)
+    };
 
     // 夹爪控制参数
     const bool use_gripper = false;
@@ -103,25 +155,93 @@ int main() {
     const int gripper_position_max = 1000; // 固定值
 
     const std::chrono::milliseconds gripper_control_duration(100); // 夹爪控制的时间间隔
-    const std::chrono::milliseconds zmq_recv_timeout(100);         // zmq 接收命令的超时时间，超时后忽略速度命令
+    const std::chrono::milliseconds zmq_recv_timeout(100);         // zmq 接收命令的超时时间，超时后忽略速度命令（xyzrpy_vel 与 joint_vel）
     const std::chrono::milliseconds zmq_pub_duration(50);          // zmq 发送机器人状态的间隔时间
-    std::chrono::steady_clock::time_point last_message_time;       // 最后一次接收到 zmq 消息的时间
-    last_message_time = std::chrono::steady_clock::now();
-
-    // zmq 获取的命令
-    std::mutex command_mutex;
-    std::array<double, 6> cartesian_velocity_cmd = {0.0};
-    std::array<double, 16> pose_matrix_cmd;
-    std::vector<double> joint_position_cmd;
+    // 命令的计划执行时间：消息带 exec_time 时为该时刻，只带发送时间 sent_time 时为发送时间加上 playout_delay，都没有时为接收时间
+    // 命令在播放缓冲中等到计划执行时间才交给实时回调，以吸收网络与推理的抖动；插值时应大于发送端的路点间隔，遥操作时可设为 0
+    // 播放缓冲按到达顺序取出，计划执行时间早于之前命令的乱序命令被丢弃
+    // sent_time 与 exec_time 为发送端时钟的秒数，用 clock_offset_window 内最小的 (接收时间 - sent_time) 换算到本地时钟
+    const std::chrono::milliseconds playout_delay(50);
+    const double clock_offset_window = 10.0;
+    // 只保留最新命令：一次取到同一类型的多条速度或位置命令时，计划执行时间已过的被后一条取代，卡顿之后不会按顺序回放积压的命令；
+    // 未到计划执行时间的命令照常提交。开启插值时位置命令是路点，不做合并；动作块、模式切换与夹爪命令不受影响
+    const bool conflateVelocity = true;  // xyzrpy_vel 与 joint_vel
+    const bool conflatePose = true;      // pose_mat 与 joint_pose，仅在 useUpsampling 关闭时
+    // 上面两类命令发送（换算到本地时钟）后超过此时间才收到、且计划执行时间已过的直接丢弃，只对带 sent_time 的消息有效
+    const std::chrono::milliseconds max_command_age(500);
+
+    // 各线程的 SCHED_FIFO 优先级（0 为普通调度）与绑定的 CPU，没有 CAP_SYS_NICE 时退回普通调度继续运行
+    const ThreadPlacement rt_placement = {"rt loop", 90, {2}};
+    const ThreadPlacement receiver_placement = {"receiver", 80, {3}};
+    const ThreadPlacement sender_placement = {"sender", 10, {1}};
+    const ThreadPlacement gripper_placement = {"gripper", 10, {1}};
+    // 启动时锁定内存，避免运行中发生缺页
+    const bool lock_memory = true;
+    PlacementResult rt_placement_result, receiver_placement_result, sender_placement_result, gripper_placement_result;
+
+    // zmq 获取的命令，由 zmq_receiver 写入完整的命令记录，实时回调无锁读取已到计划执行时间的最新一条
+    Command initial_command;                    // 初始化为当前位置，zmq_receiver 在此基础上更新
+    PlayoutBuffer<Command, 256> command_playout;
     std::atomic<float> gripper_velocity_cmd = 0.0;
-    std::atomic<bool> command_supressed = false; // 用于在 zmq 超时时忽略速度命令，位置命令不更新只会停下是安全的
+    SpscQueue<Command, 64> waypoint_queue;      // 开启插值时，与当前模式相同的位置命令按顺序交给实时回调
+    SpscQueue<ActionChunk<7>, 4> joint_chunk_queue;  // 与当前模式相同的动作块交给实时回调
+    SpscQueue<ActionChunk<3>, 4> pose_chunk_queue;
+    bool command_supressed = false; // 只由实时回调访问，用于在 zmq 超时时忽略速度命令，位置命令不更新只会停下是安全的
     std::atomic<bool> running = true;
 
+    // zmq_receiver 收到的模式切换请求，由主线程执行
+    std::mutex mode_mutex;
+    bool mode_requested = false;
+    ControlMode requested_mode;
+    std::chrono::steady_clock::time_point mode_request_time;
+    // 从收到切换请求到新模式第一次回调的时间，由实时回调写入
+    LatencyHistogram mode_switch_hist;
+    bool mode_switch_pending = false;                           // 主线程在启动控制循环前设置，实时回调读取并清除
+    std::chrono::steady_clock::time_point mode_switch_request;  // 同上
+    std::atomic<uint64_t> mode_switches{0};
+
     // zmq 发布的当前姿态
-    std::mutex pose_mutex;
-    std::array<double, 6> current_posture;
-    std::array<double, 7> current_joint;
-    std::atomic<int> gripper_position;
+    // 由实时回调每周期写入，zmq_sender 读取，机械臂与夹爪状态共用一个时间戳和序号
+    SeqLock<RobotSnapshot> state_snapshot;
+    std::atomic<int> gripper_position{0};  // 夹爪线程写入，实时回调合并进 state_snapshot
+
+    // 控制回调的延迟直方图，由实时回调写入，zmq_sender 定期发布，退出时打印
+    const std::chrono::seconds latency_pub_duration(1);  // 发布延迟统计的间隔时间
+    LatencyHistogram period_hist;        // 相邻两次回调的间隔
+    LatencyHistogram state_read_hist;    // 读取机器人状态
+    LatencyHistogram command_read_hist;  // 从 command_playout 读取命令
+    LatencyHistogram compute_hist;       // 读取状态之后到返回的计算时间
+    LatencyHistogram callback_hist;      // 整个回调
+    LatencyHistogram command_age_hist;   // 命令从接收到被回调使用经过的时间
+    LatencyHistogram command_apply_age_hist;  // 命令生效时距发送（换算到本地时钟）经过的时间，每条命令记录一次
+    LatencyHistogram jacobian_hist;      // 计算雅可比矩阵、可操作度与速度缩放，xyzrpy_vel_ik 时包括求解关节速度
+    // 每条命令到达时相对计划执行时间的提前量与迟到量，由 zmq_receiver 写入
+    LatencyHistogram playout_slack_hist;
+    LatencyHistogram playout_late_hist;
+    // xyzrpy_vel 时指令速度与实际 tcp 速度的对比，实时回调定期更新，zmq_sender 与延迟统计一起发布
+    SeqLock<VelocityTrackingSummary> tracking_summary;
+    // 当前的可操作度与速度缩放系数，以及缩放过的周期数，由实时回调写入
+    // xyzrpy_vel_ik 时缩放系数为关节速度超过 max_joint_velocity 时的等比例缩小系数
+    std::atomic<double> manipulability_now{0.0};
+    std::atomic<double> singularity_scale_now{1.0};
+    std::atomic<uint64_t> singularity_scaled{0};
+    // 安全限制的耗时与生效次数，由实时回调写入
+    LatencyHistogram safety_hist;
+    SafetyCounters safety_counters;
+    // 可达性检查的耗时与计数，由 zmq_receiver 写入
+    LatencyHistogram ik_check_hist;
+    std::atomic<uint64_t> ik_checked{0};
+    std::atomic<uint64_t> ik_unreachable{0};
+    std::atomic<uint64_t> ik_clamped{0};
+    std::atomic<uint64_t> ik_skipped{0};  // 动作块中不收敛的步之后未检查的步数
+    std::atomic<uint64_t> ik_searches{0};
+    std::atomic<uint64_t> ik_search_unreachable{0};
+    // 被同一类型更新的命令取代、过期与计划执行时间乱序而丢弃的命令数，由 zmq_receiver 写入
+    std::atomic<uint64_t> commands_conflated{0};
+    std::atomic<uint64_t> commands_stale{0};
+    std::atomic<uint64_t> commands_out_of_order{0};
+    // 类型与当前控制模式不符而被实时回调忽略的命令数
+    std::atomic<uint64_t> commands_wrong_mode{0};
 
     // 夹爪
     std::string gripper_port = "/dev/ttyUSB0";
@@ -130,6 +250,7 @@ int main() {
     DH_Gripper* gripper = gripper_factory.CreateGripper(std::string("PGE"));
 
     auto gripper_controller = [&]() {
+        applyThreadPlacement(gripper_placement, gripper_placement_result);
         // 初始化夹爪
         if (gripper->open() < 0){
             std::cerr << "无法打开通信端口: " << gripper_port << std::endl;
@@ -172,10 +293,19 @@ int main() {
 
             std::this_thread::sleep_for(gripper_control_duration);
         }
+        return 0;
     };
 
+    if (lock_memory) {
+        int err = lockProcessMemory();
+        if (err) {
+            std::cerr << "警告: mlockall 失败: " << std::strerror(err) << "，继续运行但可能发生缺页" << std::endl;
+        }
+    }
+
+    std::thread gripper_thread;
     if (use_gripper) {
-        std::thread control_thread(gripper_controller);
+        gripper_thread = std::thread(gripper_controller);
     }
 
     std::error_code ec;
@@ -208,19 +338,23 @@ int main() {
 
         rtCon->setFilterFrequency(25, 25, 52, ec);
 
-        if (usePositionControl) {
-            // 设置碰撞检测阈值
-            rtCon->setCollisionBehaviour({16, 16, 8, 8, 4, 4, 4}, ec);
-        } else {
-            // 设置阻抗系数
-            rtCon->setFcCoor(tcp_frame, rokae::FrameType::tool, ec);
-            if (cmdType == CmdType::xyzrpy_vel || cmdType == CmdType::pose_mat) {
-                rtCon->setCartesianImpedance({1200, 1200, 1200, 100, 100, 100}, ec);
-                // rtCon->setCartesianImpedanceDesiredTorque({0, 0, 0, 0, 0, 0}, ec);
-            } else if (cmdType == CmdType::joint_pose) {
-                rtCon->setJointImpedance({1200, 1200, 1200, 100, 100, 100, 100}, ec);
+        // 按控制模式设置碰撞检测阈值或阻抗系数
+        auto configure_mode = [&](const ControlMode& m) {
+            if (m.position_control) {
+                // 设置碰撞检测阈值
+                rtCon->setCollisionBehaviour({16, 16, 8, 8, 4, 4, 4}, ec);
+            } else {
+                // 设置阻抗系数
+                rtCon->setFcCoor(tcp_frame, rokae::FrameType::tool, ec);
+                if (!isJointCommand(m.cmd_type)) {
+                    rtCon->setCartesianImpedance({1200, 1200, 1200, 100, 100, 100}, ec);
+                    // rtCon->setCartesianImpedanceDesiredTorque({0, 0, 0, 0, 0, 0}, ec);
+                } else {
+                    rtCon->setJointImpedance({1200, 1200, 1200, 100, 100, 100, 100}, ec);
+                }
             }
-        }
+        };
+        configure_mode(mode);
 
         // 移动到初始位置
         std::array<double, 7> initial_joint_positions = {0, M_PI / 6, 0, M_PI / 3, 0, M_PI / 2, 0};
@@ -228,114 +362,585 @@ int main() {
 
         if(ec){
             std::cerr << "初始化失败 ec=" << ec << std::endl;
+            running = false;
+            if (gripper_thread.joinable()) {
+                gripper_thread.join();
+            }
             return 0;
         }
 
-        // 设置对应的控制模式
-        if (usePositionControl) {
-            if (cmdType == CmdType::xyzrpy_vel || cmdType == CmdType::pose_mat) {
-                rtCon->startMove(rokae::RtControllerMode::cartesianPosition);
-            } else if (cmdType == CmdType::joint_pose) {
-                rtCon->startMove(rokae::RtControllerMode::jointPosition);
-            }
-        } else {
-            if (cmdType == CmdType::xyzrpy_vel || cmdType == CmdType::pose_mat) {
-                rtCon->startMove(rokae::RtControllerMode::cartesianImpedance);
-            } else if (cmdType == CmdType::joint_pose) {
-                rtCon->startMove(rokae::RtControllerMode::jointImpedance);
+        // 在 fk_check_poses 上比对正运动学与 SDK 给出的法兰位姿，全部在容差内才使用正运动学，之后回到初始位置
+        FkCheck fk_check;
+        std::array<double, 16> fk_flange;
+        bool fk_valid = useAnalyticFk;
+        if (useAnalyticFk) {
+            for (const auto& check_pose : fk_check_poses) {
+                rtCon->MoveJ(0.3, robot.jointPos(ec), check_pose);
+                RobotState check_state;
+                readRobotStateQuery(robot, tcp_frame, check_state, ec);
+                forwardKinematics(check_state.joint_pos, fk_flange);
+                fk_check.update(fk_flange, check_state.flange_in_base);
+                fk_valid = fk_valid && !ec && fk_check.withinTolerance(fk_position_tolerance, fk_rotation_tolerance);
+            }
+            rtCon->MoveJ(0.3, robot.jointPos(ec), initial_joint_positions);
+            fk_check.print("analytic fk vs sdk");
+            if (!fk_valid) {
+                std::cerr << "正运动学与 SDK 位姿不一致，使用 SDK 位姿" << std::endl;
             }
         }
+        // 运行中的比对失败时由实时回调清除，zmq_receiver 与主线程随之停用依赖运动学模型的功能
+        std::atomic<bool> fk_enabled{fk_valid};
+        // xyzrpy_vel_ik 的雅可比矩阵来自 DH 模型，模型未通过比对时不能以该模式启动
+        if (mode.cmd_type == CmdType::xyzrpy_vel_ik && !fk_valid) {
+            std::cerr << "运动学模型未通过比对（或未开启 useAnalyticFk），不能使用 xyzrpy_vel_ik" << std::endl;
+            running = false;
+            if (gripper_thread.joinable()) {
+                gripper_thread.join();
+            }
+            return 0;
+        }
+
+        // 设置对应的控制模式
+        auto start_move = [&](const ControlMode& m) {
+            if (m.position_control) {
+                if (!isJointCommand(m.cmd_type)) {
+                    rtCon->startMove(rokae::RtControllerMode::cartesianPosition);
+                } else {
+                    rtCon->startMove(rokae::RtControllerMode::jointPosition);
+                }
+            } else {
+                if (!isJointCommand(m.cmd_type)) {
+                    rtCon->startMove(rokae::RtControllerMode::cartesianImpedance);
+                } else {
+                    rtCon->startMove(rokae::RtControllerMode::jointImpedance);
+                }
+            }
+        };
+        start_move(mode);
+
+        // 目标位姿的可达性检查，只由 zmq_receiver 调用
+        AsyncIkSearch<XMateEr7Pro> ik_search(ik_config, useReachabilityCheck ? ik_threads : 0);
+        std::array<double, 16> tcp_frame_inverse;
+        invertTransform(tcp_frame, tcp_frame_inverse);
+
+        // 通知 zmq_receiver 退出
+        WakeupFd receiver_wakeup;
 
         // zmq 收期望的速度
         auto zmq_receiver = [&]() {
+            applyThreadPlacement(receiver_placement, receiver_placement_result);
             zmq::context_t context(1);
             zmq::socket_t subscriber(context, ZMQ_SUB);
             subscriber.connect(zmq_recv_addr);
             subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0); // 订阅所有消息
             std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
 
-            std::array<double, 6> cartesian_velocity;
-            std::array<double, 16> pose_matrix;
-            std::array<double, 7> joint_position;
-            
+            // 只更新收到的字段，再整体写入 command_playout
+            Command command = initial_command;
+            ClockMapper sender_clock(clock_offset_window);
+            ActionChunk<7> joint_chunk;
+            ActionChunk<3> pose_chunk;
+            ControlMode mode_request = mode;
+
+            // 检查 count 个 tcp 目标位姿的可达性，每个目标只从上一个目标的解迭代，不收敛时提交后台搜索并停止检查其后的目标
+            // 后台搜索确认不可达后，clampUnreachable 时把不收敛的目标及其后的目标原地换成误差最小的位姿
+            std::array<double, 7> ik_seed = command.joint_position;
+            std::array<double, 16> ik_target;
+            IkResult ik_result;
+            bool search_unreachable = false;
+            auto last_search = std::chrono::steady_clock::time_point();
+            auto check_reachability = [&](std::array<double, 16>* tcp_targets, std::size_t count) {
+                if (!fk_enabled.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                auto start = std::chrono::steady_clock::now();
+                if (ik_search.poll(ik_result)) {
+                    ik_searches.fetch_add(1, std::memory_order_relaxed);
+                    search_unreachable = !ik_result.reachable;
+                    if (ik_result.reachable) {
+                        ik_seed = ik_result.q;
+                    } else {
+                        ik_search_unreachable.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                // 不收敛的迭代用满 max_iterations，每条消息最多一次，其后的目标不再检查
+                std::size_t checked = 0;
+                while (checked < count) {
+                    multiplyTransforms(tcp_targets[checked], tcp_frame_inverse, ik_target);
+                    if (!solveIkFromSeed<XMateEr7Pro>(ik_target, ik_seed, ik_config, ik_result)) {
+                        break;
+                    }
+                    ik_seed = ik_result.q;
+                    search_unreachable = false;
+                    ++checked;
+                }
+                if (checked < count) {
+                    std::size_t skipped = count - checked - 1;
+                    std::size_t clamped = 0;
+                    if (start - last_search >= ik_search_interval && ik_search.submit(ik_target, ik_seed)) {
+                        last_search = start;
+                    }
+                    if (search_unreachable && clampUnreachable) {
+                        // 其后的目标停在同一个最近的可达位姿，下一个动作块重新检查
+                        forwardKinematicsTcp(ik_result.q, tcp_frame, tcp_targets[checked]);
+                        for (std::size_t i = checked + 1; i < count; ++i) {
+                            tcp_targets[i] = tcp_targets[checked];
+                        }
+                        ik_seed = ik_result.q;
+                        clamped = count - checked;
+                    }
+                    ik_unreachable.fetch_add(1, std::memory_order_relaxed);
+                    ik_clamped.fetch_add(clamped, std::memory_order_relaxed);
+                    ik_skipped.fetch_add(skipped, std::memory_order_relaxed);
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn,
+                                          "警告: 目标位姿从上一个解迭代不收敛（误差 %.1fmm %.1fmrad），其后 %.0f 个未检查，%.0f 个已替换为最近的可达位姿",
+                                          ik_result.position_error * 1e3, ik_result.rotation_error * 1e3, skipped, clamped);
+                    ++checked;
+                }
+                ik_check_hist.record(std::chrono::steady_clock::now() - start);
+                ik_checked.fetch_add(checked, std::memory_order_relaxed);
+            };
+
+            // JSON 与二进制消息共用的动作块处理，joint_chunk.p 或 chunk_matrices 已填好前 steps 步
+            CmdType active = active_cmd_type.load(std::memory_order_relaxed);
+            std::array<std::array<double, 16>, ActionChunk<3>::kMaxSteps> chunk_matrices;
+            auto chunk_steps = [](std::size_t steps) {
+                if (steps > ActionChunk<7>::kMaxSteps) {
+                    std::cerr << "动作块长度 " << steps << " 超过 " << ActionChunk<7>::kMaxSteps << "，截断" << std::endl;
+                    steps = ActionChunk<7>::kMaxSteps;
+                }
+                return steps;
+            };
+            auto submit_chunk = [&](bool is_joint, double start, double period, std::size_t steps) {
+                if (!(period > 0.0) || steps == 0) {
+                    std::cerr << "动作块缺少 chunk_period 或为空" << std::endl;
+                    return false;
+                }
+                CmdType chunk_type = is_joint ? CmdType::joint_chunk : CmdType::pose_chunk;
+                command.type = chunk_type;
+                if (chunk_type != active) {
+                    return true;
+                }
+                bool pushed;
+                if (is_joint) {
+                    joint_chunk.start = start;
+                    joint_chunk.period = period;
+                    joint_chunk.steps = static_cast<uint32_t>(steps);
+                    pushed = joint_chunk_queue.push(joint_chunk);
+                } else {
+                    pose_chunk.start = start;
+                    pose_chunk.period = period;
+                    pose_chunk.steps = static_cast<uint32_t>(steps);
+                    if (useReachabilityCheck) {
+                        check_reachability(chunk_matrices.data(), steps);
+                    }
+                    for (std::size_t i = 0; i < steps; ++i) {
+                        poseFromMatrix(chunk_matrices[i], pose_chunk.p[i], pose_chunk.q[i]);
+                    }
+                    pushed = pose_chunk_queue.push(pose_chunk);
+                }
+                if (!pushed) {
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 动作块队列已满，丢弃动作块");
+                }
+                return true;
+            };
+            WireView wire;
+
+            // 速度与位置命令先暂存最新的一条，本批消息取完、收到其它命令或暂存的命令未到期时再提交
+            auto conflated = [&](CmdType type) {
+                return (conflateVelocity && isVelocityCommand(type)) ||
+                       (conflatePose && !useUpsampling && (type == CmdType::pose_mat || type == CmdType::joint_pose));
+            };
+            // timed 为 false 的命令没有时间戳，立即执行，作为路点时仍滞后 playout_delay 插值
+            std::chrono::steady_clock::time_point last_due;
+            auto submit_command = [&](const Command& cmd, bool timed) {
+                // 播放缓冲按顺序取出，早于前一条命令到期的命令会被排在后面，只能丢弃
+                if (cmd.due_time < last_due) {
+                    commands_out_of_order.fetch_add(1, std::memory_order_relaxed);
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 丢弃计划执行时间早于前一条命令 %.1fms 的命令",
+                                          std::chrono::duration<double, std::milli>(last_due - cmd.due_time).count());
+                    return;
+                }
+                last_due = cmd.due_time;
+                auto now = std::chrono::steady_clock::now();
+                if (cmd.due_time >= now) {
+                    playout_slack_hist.record(cmd.due_time - now);
+                } else {
+                    playout_late_hist.record(now - cmd.due_time);
+                }
+                if (!command_playout.push(cmd)) {
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 命令播放缓冲已满，丢弃命令");
+                }
+                if (useUpsampling && cmd.type == active && (active == CmdType::joint_pose || active == CmdType::pose_mat)) {
+                    bool pushed;
+                    if (timed) {
+                        pushed = waypoint_queue.push(cmd);
+                    } else {
+                        Command waypoint = cmd;
+                        waypoint.due_time += playout_delay;
+                        pushed = waypoint_queue.push(waypoint);
+                    }
+                    if (!pushed) {
+                        logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 路点队列已满，丢弃路点");
+                    }
+                }
+            };
+            Command latest_command;
+            bool latest_timed = false;
+            bool has_latest = false;
+            auto flush_latest = [&]() {
+                if (has_latest) {
+                    submit_command(latest_command, latest_timed);
+                    has_latest = false;
+                }
+            };
+            JsonCommandScanner json_scanner;
+            JsonCommand json_command;
+            JsonArena receiver_arena(1 << 16);
+
+            // 没有消息时阻塞在 zmq_poll 上，直到有新消息或 receiver_wakeup 通知退出，空闲时不占用 CPU
+            zmq::pollitem_t poll_items[] = {{subscriber.handle(), 0, ZMQ_POLLIN, 0},
+                                            {nullptr, receiver_wakeup.fd(), ZMQ_POLLIN, 0}};
             while (running) {
-                zmq::message_t message;
-                zmq::recv_result_t received = subscriber.recv(message, zmq::recv_flags::dontwait); // 不阻塞
-                if (received) {
+                zmq::poll(poll_items, 2, std::chrono::milliseconds(-1));
+                if (poll_items[1].revents & ZMQ_POLLIN) {
+                    receiver_wakeup.drain();
+                }
+                // 一次取完所有已到达的消息
+                while (running) {
+                    zmq::message_t message;
+                    zmq::recv_result_t received = subscriber.recv(message, zmq::recv_flags::dontwait);
+                    if (!received) {
+                        break;
+                    }
                     auto current_time = std::chrono::steady_clock::now();
                     std::chrono::duration<double, std::milli> elapsed = current_time - last_time;
                     double dt = elapsed.count();
                     last_time = current_time;
 
-                    std::string msg_str(static_cast<char*>(message.data()), message.size());
-                    json msg_json = json::parse(msg_str);
-
-                    if (msg_json.contains("cartesian_velocity")) {
-                        cartesian_velocity = msg_json["cartesian_velocity"].get<std::array<double, 6>>();
-                        {
-                            std::lock_guard<std::mutex> lock(command_mutex);
-                            cartesian_velocity_cmd = cartesian_velocity;
-                            command_supressed = false;
-                            last_message_time = current_time;
+                    bool known_command = true;
+                    active = active_cmd_type.load(std::memory_order_relaxed);
+                    // 计划执行时间的依据，均为发送端时钟
+                    bool has_sent_time = false;
+                    bool has_exec_time = false;
+                    double sent_time = 0.0;
+                    double exec_time = 0.0;
+                    const char* text = static_cast<const char*>(message.data());
+                    bool is_wire = isWireMessage(text, message.size());
+                    // 只含常见键的 JSON 命令由扫描器直接解码到 json_command，含 mode、动作块等其它键时再构造完整的 json
+                    JsonScanStatus json_status =
+                        is_wire ? JsonScanStatus::fallback : json_scanner.scan(text, message.size(), json_command);
+                    if (is_wire) {
+                        // 二进制消息：在 message 的内存上直接解码
+                        WireStatus status = wire.parse(message.data(), message.size());
+                        if (status != WireStatus::ok) {
+                            known_command = false;
+                            std::cerr << "无法解码的二进制命令: " << wireStatusName(status) << std::endl;
+                        } else {
+                            const WireHeader& header = wire.header();
+                            has_sent_time = wire.hasSentTime();
+                            has_exec_time = wire.hasExecTime();
+                            sent_time = header.sent_time;
+                            exec_time = header.exec_time;
+                            if (wire.hasGripper()) {
+                                gripper_velocity_cmd = static_cast<float>(header.gripper_velocity);
+                            }
+                            switch (wire.type()) {
+                                case WireType::none:
+                                    known_command = false;
+                                    break;
+                                case WireType::cartesian_velocity:
+                                    command.type = CmdType::xyzrpy_vel;
+                                    wire.step(0, command.cartesian_velocity);
+                                    break;
+                                case WireType::pose_matrix:
+                                    command.type = CmdType::pose_mat;
+                                    wire.step(0, command.pose_matrix);
+                                    if (useReachabilityCheck && active == CmdType::pose_mat) {
+                                        check_reachability(&command.pose_matrix, 1);
+                                    }
+                                    break;
+                                case WireType::joint_position:
+                                    command.type = CmdType::joint_pose;
+                                    wire.step(0, command.joint_position);
+                                    break;
+                                case WireType::joint_velocity:
+                                    command.type = CmdType::joint_vel;
+                                    wire.step(0, command.joint_velocity);
+                                    break;
+                                case WireType::joint_chunk:
+                                case WireType::pose_chunk: {
+                                    bool is_joint = wire.type() == WireType::joint_chunk;
+                                    std::size_t steps = chunk_steps(wire.steps());
+                                    for (std::size_t i = 0; i < steps; ++i) {
+                                        if (is_joint) {
+                                            wire.step(i, joint_chunk.p[i]);
+                                        } else {
+                                            wire.step(i, chunk_matrices[i]);
+                                        }
+                                    }
+                                    double start = header.chunk_start > 0.0 ? header.chunk_start : steadySeconds(current_time);
+                                    known_command = submit_chunk(is_joint, start, header.chunk_period, steps);
+                                    break;
+                                }
+                            }
                         }
-
-                        #ifdef DEBUG
-                        std::cout << "zmq recv v=[" << cartesian_velocity[0] << ", " << cartesian_velocity[1] 
-                                    << ", " << cartesian_velocity[2] << "]"<< cartesian_velocity[3] << ", " << cartesian_velocity[4] 
-                                    << ", " << cartesian_velocity[5] <<" elapsed=" << dt << "ms" << std::endl;
-                        #endif
-                    } else if (msg_json.contains("pose_matrix")){
-                        pose_matrix = msg_json["pose_matrix"].get<std::array<double, 16>>();
-                        {
-                            std::lock_guard<std::mutex> lock(command_mutex);
-                            pose_matrix_cmd = pose_matrix;
-                            last_message_time = current_time;
+                    } else if (json_status == JsonScanStatus::malformed) {
+                        known_command = false;
+                        std::cerr << "无法解析的zmq消息: " << std::string(text, message.size()) << std::endl;
+                    } else if (json_status == JsonScanStatus::ok) {
+                        if (json_command.has(JsonCommand::kCartesianVelocity)) {
+                            command.type = CmdType::xyzrpy_vel;
+                            command.cartesian_velocity = json_command.cartesian_velocity;
+                        } else if (json_command.has(JsonCommand::kPoseMatrix)) {
+                            command.type = CmdType::pose_mat;
+                            command.pose_matrix = json_command.pose_matrix;
+                            if (useReachabilityCheck && active == CmdType::pose_mat) {
+                                check_reachability(&command.pose_matrix, 1);
+                            }
+                        } else if (json_command.has(JsonCommand::kJointPosition)) {
+                            command.type = CmdType::joint_pose;
+                            command.joint_position = json_command.joint_position;
+                        } else if (json_command.has(JsonCommand::kJointVelocity)) {
+                            command.type = CmdType::joint_vel;
+                            command.joint_velocity = json_command.joint_velocity;
+                        } else {
+                            known_command = false;
+                            std::cerr << "未知的zmq控制命令" << std::string(text, message.size()) << std::endl;
                         }
-                    } else if (msg_json.contains("joint_position")){
-                        joint_position = msg_json["joint_position"].get<std::array<double, 7>>();
-                        {
-                            std::lock_guard<std::mutex> lock(command_mutex);
-                            joint_position_cmd.clear();
-                            std::copy(joint_position.begin(), joint_position.end(), std::back_inserter(joint_position_cmd));
-                            last_message_time = current_time;
+                        has_sent_time = json_command.has(JsonCommand::kSentTime);
+                        has_exec_time = json_command.has(JsonCommand::kExecTime);
+                        sent_time = json_command.sent_time;
+                        exec_time = json_command.exec_time;
+                        if (json_command.has(JsonCommand::kGripperVelocity)) {
+                            gripper_velocity_cmd = static_cast<float>(json_command.gripper_velocity);
                         }
                     } else {
-                        std::cerr << "未知的zmq控制命令" << msg_json << std::endl;
+                        // 完整的 json 在 receiver_arena 上分配，这条消息处理完后整块回收
+                        JsonArenaScope arena_scope(receiver_arena);
+                        arena_json& msg_json = receiver_arena.make<arena_json>(
+                            arena_json::parse(text, text + message.size(), nullptr, false));
+                        if (msg_json.is_discarded() || !msg_json.is_object()) {
+                            std::cerr << "无法解析的zmq消息: " << std::string(text, message.size()) << std::endl;
+                            continue;
+                        }
+
+                        if (msg_json.contains("mode")) {
+                            // 模式切换请求，交给主线程执行
+                            // 类型不符的字段会让 get/value 抛出异常，接收线程上没有处理，先检查类型再丢弃
+                            known_command = false;
+                            auto is_bool_or_absent = [&](const char* key) {
+                                return !msg_json.contains(key) || msg_json[key].is_boolean();
+                            };
+                            if (!msg_json["mode"].is_string() || !is_bool_or_absent("position_control") ||
+                                !is_bool_or_absent("desired_pose") || !is_bool_or_absent("tcp_move")) {
+                                std::cerr << "格式错误的模式切换请求: " << msg_json << std::endl;
+                            } else if (!parseCmdType(msg_json["mode"].get<std::string>(), mode_request.cmd_type)) {
+                                std::cerr << "未知的控制模式" << msg_json["mode"] << std::endl;
+                            } else {
+                                mode_request.position_control = msg_json.value("position_control", mode_request.position_control);
+                                mode_request.desired_pose = msg_json.value("desired_pose", mode_request.desired_pose);
+                                mode_request.tcp_move = msg_json.value("tcp_move", mode_request.tcp_move);
+                                std::lock_guard<std::mutex> lock(mode_mutex);
+                                requested_mode = mode_request;
+                                mode_request_time = current_time;
+                                mode_requested = true;
+                            }
+                        } else if (msg_json.contains("cartesian_velocity")) {
+                            command.type = CmdType::xyzrpy_vel;
+                            command.cartesian_velocity = msg_json["cartesian_velocity"].get<std::array<double, 6>>();
+
+                            #ifdef DEBUG
+                            const auto& cartesian_velocity = command.cartesian_velocity;
+                            std::cout << "zmq recv v=[" << cartesian_velocity[0] << ", " << cartesian_velocity[1] 
+                                        << ", " << cartesian_velocity[2] << "]"<< cartesian_velocity[3] << ", " << cartesian_velocity[4] 
+                                        << ", " << cartesian_velocity[5] <<" elapsed=" << dt << "ms" << std::endl;
+                            #endif
+                        } else if (msg_json.contains("pose_matrix")){
+                            command.type = CmdType::pose_mat;
+                            command.pose_matrix = msg_json["pose_matrix"].get<std::array<double, 16>>();
+                            if (useReachabilityCheck && active == CmdType::pose_mat) {
+                                check_reachability(&command.pose_matrix, 1);
+                            }
+                        } else if (msg_json.contains("joint_position")){
+                            command.type = CmdType::joint_pose;
+                            command.joint_position = msg_json["joint_position"].get<std::array<double, 7>>();
+                        } else if (msg_json.contains("joint_velocity")){
+                            command.type = CmdType::joint_vel;
+                            command.joint_velocity = msg_json["joint_velocity"].get<std::array<double, 7>>();
+                        } else if (msg_json.contains("joint_chunk") || msg_json.contains("pose_chunk")) {
+                            // 动作块：chunk_start 为第一个动作的执行时刻，与发布的 Timestamp 使用同一时钟，省略时为接收时刻
+                            // 每一步必须是长度正确的数字数组、时间必须是数字，否则整块丢弃（get/value 会抛出异常）
+                            bool is_joint = msg_json.contains("joint_chunk");
+                            const arena_json& actions = is_joint ? msg_json["joint_chunk"] : msg_json["pose_chunk"];
+                            std::size_t width = is_joint ? 7 : 16;
+                            auto is_action = [&](const arena_json& action) {
+                                return action.is_array() && action.size() == width &&
+                                       std::all_of(action.begin(), action.end(), [](const arena_json& v) { return v.is_number(); });
+                            };
+                            auto is_number_or_absent = [&](const char* key) {
+                                return !msg_json.contains(key) || msg_json[key].is_number();
+                            };
+                            if (!actions.is_array() || !std::all_of(actions.begin(), actions.end(), is_action) ||
+                                !is_number_or_absent("chunk_start") || !is_number_or_absent("chunk_period")) {
+                                known_command = false;
+                                std::cerr << "格式错误的动作块，丢弃" << std::endl;
+                            } else {
+                                std::size_t steps = chunk_steps(actions.size());
+                                for (std::size_t i = 0; i < steps; ++i) {
+                                    if (is_joint) {
+                                        joint_chunk.p[i] = actions[i].get<std::array<double, 7>>();
+                                    } else {
+                                        chunk_matrices[i] = actions[i].get<std::array<double, 16>>();
+                                    }
+                                }
+                                known_command = submit_chunk(is_joint, msg_json.value("chunk_start", steadySeconds(current_time)),
+                                                             msg_json.value("chunk_period", 0.0), steps);
+                            }
+                        } else {
+                            known_command = false;
+                            std::cerr << "未知的zmq控制命令" << msg_json << std::endl;
+                        }
+
+                        has_sent_time = msg_json.contains("sent_time");
+                        has_exec_time = msg_json.contains("exec_time");
+                        sent_time = msg_json.value("sent_time", 0.0);
+                        exec_time = msg_json.value("exec_time", 0.0);
+                        if (msg_json.contains("gripper_velocity")) {
+                            gripper_velocity_cmd = msg_json["gripper_velocity"];
+                        }
                     }
 
-                    if (msg_json.contains("gripper_velocity"))
-                    {
-                        gripper_velocity_cmd = msg_json["gripper_velocity"];
+                    if (known_command) {
+                        // 计划执行时间
+                        double due;
+                        if (has_sent_time) {
+                            sender_clock.update(sent_time, steadySeconds(current_time));
+                            if (has_exec_time) {
+                                due = sender_clock.map(exec_time);
+                            } else {
+                                due = sender_clock.map(sent_time) + std::chrono::duration<double>(playout_delay).count();
+                            }
+                        } else {
+                            due = steadySeconds(current_time);
+                        }
+                        command.recv_time = current_time;
+                        command.due_time = steadyTimePoint(due);
+                        command.sent_time = has_sent_time ? steadyTimePoint(sender_clock.map(sent_time)) : current_time;
+                        ++command.seq;
+                        if (!conflated(command.type)) {
+                            flush_latest();
+                            submit_command(command, has_sent_time);
+                        } else if (current_time - command.sent_time > max_command_age && command.due_time <= current_time) {
+                            commands_stale.fetch_add(1, std::memory_order_relaxed);
+                            logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 丢弃发送后 %.1fms 才收到的命令",
+                                                  std::chrono::duration<double, std::milli>(current_time - command.sent_time).count());
+                        } else {
+                            // 只取代计划执行时间已过的同类型命令，未到期的先提交，由播放缓冲按时执行
+                            if (has_latest && latest_command.type == command.type && latest_command.due_time <= current_time) {
+                                commands_conflated.fetch_add(1, std::memory_order_relaxed);
+                            } else {
+                                flush_latest();
+                            }
+                            latest_command = command;
+                            latest_timed = has_sent_time;
+                            has_latest = true;
+                        }
                     }
                 }
+                flush_latest();
             }
         };
 
         // zmq 发送当前状态
         auto zmq_sender = [&]() {
+            applyThreadPlacement(sender_placement, sender_placement_result);
             zmq::context_t context(1);
             zmq::socket_t publisher(context, ZMQ_PUB);
             publisher.bind(zmq_pub_addr);
+            auto last_latency_pub = std::chrono::steady_clock::now();
+            // 每条消息的 json 在 sender_arena 上分配，序列化到复用的 msg_str，稳定后不调用 malloc
+            JsonArena sender_arena(1 << 16);
+            std::string msg_str;
+            msg_str.reserve(8192);
 
             while (running) {
-                // 复制当前姿态
-                std::array<double, 6> posture_copy;
-                std::array<double, 7> joint_copy;
-                double gripper_copy;
-                {
-                    std::lock_guard<std::mutex> lock(pose_mutex);
-                    posture_copy = current_posture;
-                    joint_copy = current_joint;
-                    gripper_copy = gripper_position / gripper_position_max;
-                }
+                // 复制当前状态，读到撕裂的快照时重试
+                RobotSnapshot snapshot;
+                state_snapshot.load(snapshot);
+                const auto& posture_copy = snapshot.tcp_posture;
+                const auto& joint_copy = snapshot.joint_pos;
 
                 // 创建 JSON 消息
-                json msg_json;
+                JsonArenaScope arena_scope(sender_arena);
+                arena_json& msg_json = sender_arena.make<arena_json>();
+                msg_json["Seq"] = snapshot.seq;
+                msg_json["Timestamp"] = snapshot.stamp_ns * 1e-9;  // steady_clock 秒
                 msg_json["ActualTCPPose"] = {posture_copy[0], posture_copy[1], posture_copy[2],posture_copy[3], posture_copy[4], posture_copy[5]};
                 msg_json["ActualJointPose"] = {joint_copy[0], joint_copy[1], joint_copy[2], joint_copy[3], joint_copy[4], joint_copy[5], joint_copy[6]};
-                msg_json["ActualGripperPose"] = gripper_copy;
+                msg_json["ActualGripperPose"] = snapshot.gripper_position;
+                msg_json["Mode"] = cmdTypeName(active_cmd_type.load(std::memory_order_relaxed));
+
+                // 定期附带回调的延迟统计
+                auto now = std::chrono::steady_clock::now();
+                if (now - last_latency_pub >= latency_pub_duration) {
+                    last_latency_pub = now;
+                    arena_json& latency = msg_json["Latency"];
+                    latencyToJson(period_hist, latency["period"]);
+                    latencyToJson(state_read_hist, latency["state_read"]);
+                    latencyToJson(command_read_hist, latency["command_read"]);
+                    latencyToJson(compute_hist, latency["compute"]);
+                    latencyToJson(callback_hist, latency["callback"]);
+                    latencyToJson(command_age_hist, latency["command_age"]);
+                    latencyToJson(command_apply_age_hist, latency["command_apply_age"]);
+                    latencyToJson(jacobian_hist, latency["jacobian"]);
+                    latencyToJson(safety_hist, latency["safety"]);
+                    latencyToJson(playout_slack_hist, latency["playout_slack"]);
+                    latencyToJson(playout_late_hist, latency["playout_late"]);
+                    latencyToJson(mode_switch_hist, latency["mode_switch"]);
+                    if (useSafetyFilter) {
+                        arena_json& safety = msg_json["Safety"];
+                        safety["non_finite"] = safety_counters.non_finite.load(std::memory_order_relaxed);
+                        safety["workspace"] = safety_counters.workspace.load(std::memory_order_relaxed);
+                        safety["linear_step"] = safety_counters.linear_step.load(std::memory_order_relaxed);
+                        safety["angular_step"] = safety_counters.angular_step.load(std::memory_order_relaxed);
+                        safety["joint_limit"] = safety_counters.joint_limit.load(std::memory_order_relaxed);
+                        safety["joint_step"] = safety_counters.joint_step.load(std::memory_order_relaxed);
+                    }
+                    arena_json& conflation = msg_json["Conflation"];
+                    conflation["conflated"] = commands_conflated.load(std::memory_order_relaxed);
+                    conflation["stale"] = commands_stale.load(std::memory_order_relaxed);
+                    conflation["out_of_order"] = commands_out_of_order.load(std::memory_order_relaxed);
+                    conflation["wrong_mode"] = commands_wrong_mode.load(std::memory_order_relaxed);
+                    if (ik_checked.load(std::memory_order_relaxed) > 0) {
+                        arena_json& reachability = msg_json["Reachability"];
+                        reachability["checked"] = ik_checked.load(std::memory_order_relaxed);
+                        reachability["unreachable"] = ik_unreachable.load(std::memory_order_relaxed);
+                        reachability["clamped"] = ik_clamped.load(std::memory_order_relaxed);
+                        reachability["skipped"] = ik_skipped.load(std::memory_order_relaxed);
+                        reachability["searches"] = ik_searches.load(std::memory_order_relaxed);
+                        reachability["search_unreachable"] = ik_search_unreachable.load(std::memory_order_relaxed);
+                        latencyToJson(ik_check_hist, reachability["latency"]);
+                    }
+                    if (jacobian_hist.count() > 0) {
+                        arena_json& singularity = msg_json["Singularity"];
+                        singularity["manipulability"] = manipulability_now.load(std::memory_order_relaxed);
+                        singularity["scale"] = singularity_scale_now.load(std::memory_order_relaxed);
+                        singularity["scaled"] = singularity_scaled.load(std::memory_order_relaxed);
+                    }
+                    VelocityTrackingSummary tracking;
+                    tracking_summary.load(tracking);
+                    arena_json& velocity_tracking = msg_json["VelocityTracking"];
+                    velocity_tracking["n"] = tracking.samples;
+                    velocity_tracking["linear_rms"] = tracking.linear_rms_error;
+                    velocity_tracking["linear_max"] = tracking.linear_max_error;
+                    velocity_tracking["linear_ratio"] = tracking.linear_ratio;
+                    velocity_tracking["angular_rms"] = tracking.angular_rms_error;
+                    velocity_tracking["angular_max"] = tracking.angular_max_error;
+                    velocity_tracking["angular_ratio"] = tracking.angular_ratio;
+                }
 
-                std::string msg_str = msg_json.dump();
+                dumpJson(msg_json, msg_str);
                 // std::cout<<msg_str<<"\n";
                 // 发送消息
                 zmq::message_t message(msg_str.size());
@@ -352,107 +957,457 @@ int main() {
 
         // callback_cart 返回的目标变换矩阵，使用当前值初始化
         std::array<double, 16> target_pose_matrix;
-        std::array<double, 6> current_posture_flange;
-        current_posture_flange = robot.posture(rokae::CoordinateType::flangeInBase, ec);
-        rokae::Utils::postureToTransArray(current_posture_flange, target_pose_matrix);
-        // 使用 tcp_frame 计算当前 tcp 在 base 中的坐标来初始化 target_pose_matrix 和 current_posture
-        std::array<double, 16> tcp_in_base;
-        multiplyMatrices<4>(target_pose_matrix, tcp_frame, tcp_in_base);
-        target_pose_matrix = tcp_in_base;
-        extractXYZRPY(tcp_in_base, current_posture);
+        // 使用 tcp_frame 计算当前 tcp 在 base 中的坐标来初始化 target_pose_matrix 和 state_snapshot
+        RobotState initial_state;
+        readRobotStateQuery(robot, tcp_frame, initial_state, ec);
+        target_pose_matrix = initial_state.tcp_in_base;
+        RobotSnapshot initial_snapshot;
+        fillSnapshot(initial_state, gripper_position.load() / static_cast<double>(gripper_position_max), initial_snapshot);
+        state_snapshot.store(initial_snapshot);
 
         // callback_joint 返回的关节角度，使用当前值初始化
-        std::vector<double> target_joint_pose;
-        current_joint = robot.jointPos(ec);
-        std::copy(current_joint.begin(), current_joint.end(), std::back_inserter(target_joint_pose));
+        // joint_output 预先分配好 7 个关节，回调中只原地拷贝
+        std::array<double, 7> target_joint_pose = initial_state.joint_pos;
+        rokae::JointPosition joint_output(target_joint_pose.size());
 
         // 同时初始化位置控制命令为当前位置
-        pose_matrix_cmd = target_pose_matrix;
-        joint_position_cmd = target_joint_pose;
+        initial_command.type = messageType(mode.cmd_type);
+        initial_command.pose_matrix = target_pose_matrix;
+        initial_command.joint_position = initial_state.joint_pos;
+        initial_command.recv_time = std::chrono::steady_clock::now();
+        initial_command.due_time = initial_command.recv_time;
+        initial_command.sent_time = initial_command.recv_time;
+        command_playout.push(initial_command);
 
         // 启动 zmq 发布和订阅线程
         std::thread zmq_sender_thread(zmq_sender);
         std::thread zmq_receiver_thread(zmq_receiver);
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-        // 轴空间控制时的回调函数
-        std::function<rokae::JointPosition()> callback_joint = [&, rtCon]() {
+        // 每个周期的机器人状态与回调耗时统计，回调外预分配
+        RobotState robot_state = initial_state;
+        RobotSnapshot robot_snapshot;
+        std::chrono::steady_clock::time_point last_callback_start;
+        std::chrono::steady_clock::time_point state_read_end;
+
+        // 回调开始时记录周期间隔
+        auto begin_tick = [&](std::chrono::steady_clock::time_point callback_start) {
+            if (last_callback_start.time_since_epoch().count() != 0) {
+                period_hist.record(callback_start - last_callback_start);
+            }
+            last_callback_start = callback_start;
+            if (mode_switch_pending) {
+                mode_switch_pending = false;
+                mode_switch_hist.record(callback_start - mode_switch_request);
+            }
+        };
+
+        // 回调返回前记录计算时间与总耗时
+        auto end_tick = [&](std::chrono::steady_clock::time_point callback_start) {
+            auto callback_end = std::chrono::steady_clock::now();
+            compute_hist.record(callback_end - state_read_end);
+            callback_hist.record(callback_end - callback_start);
+        };
+
+        // 读取当前的机器人状态并发布状态快照
+        auto read_state = [&]() {
             auto start1 = std::chrono::steady_clock::now();
-            // 获取当前的机器人状态：末端执行器姿态/轴角
-            // TODO 耗时可能比较长，切换为setControlLoop(useStateDataInLoop=True)和getStateData
-            std::array<double, 6> current_posture_flange = robot.posture(rokae::CoordinateType::flangeInBase, ec);
-            std::array<double, 16> current_mat_temp;
-            rokae::Utils::postureToTransArray(current_posture_flange, current_mat_temp);
-            std::array<double, 16> tcp_in_base;
-            multiplyMatrices<4>(current_mat_temp, tcp_frame, tcp_in_base);
-            std::array<double, 6> current_posture_temp;
-            extractXYZRPY(tcp_in_base, current_posture_temp);
-
-            std::array<double, 7> joint_pose_temp = robot.jointPos(ec);
-            auto now = std::chrono::steady_clock::now();
-            std::chrono::duration<double, std::milli> dur1 = now - start1;
-            if (dur1.count() > 1){
-                std::cout<< "robot.posture=" << dur1.count() << "ms" << std::endl;
-            }
-
-            // 更新共享的当前姿态
-            {
-                std::lock_guard<std::mutex> lock(pose_mutex);
-                current_posture = current_posture_temp;
-                current_joint = joint_pose_temp;
+            bool analytic_fk = fk_enabled.load(std::memory_order_relaxed);
+            if (useStateDataInLoop) {
+                readRobotStateInLoop(robot, tcp_frame, robot_state, analytic_fk);
+            } else {
+                readRobotStateQuery(robot, tcp_frame, robot_state, ec, analytic_fk);
+            }
+            state_read_end = std::chrono::steady_clock::now();
+            if (analytic_fk && useStateDataInLoop && robot_state.cycle % fk_check_interval == 0) {
+                if (robot.getStateData(rokae::RtSupportedFields::tcpPose_m, fk_flange) == 0) {
+                    fk_check.update(robot_state.flange_in_base, fk_flange);
+                    // 从下一个周期起使用 SDK 位姿
+                    if (!fk_check.withinTolerance(fk_position_tolerance, fk_rotation_tolerance)) {
+                        fk_enabled.store(false, std::memory_order_relaxed);
+                        logger.log(LogLevel::error, "正运动学与 SDK 位姿相差 %.3fmm %.3fmrad，改用 SDK 位姿，停用奇异位形缩放、xyzrpy_vel_ik 与可达性检查",
+                                   fk_check.lastPositionError() * 1e3, fk_check.lastRotationError() * 1e3);
+                    }
+                }
+            }
+            auto dur1 = state_read_end - start1;
+            state_read_hist.record(dur1);
+            if (dur1 > std::chrono::milliseconds(1)){
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "robot state read=%.3fms",
+                                      std::chrono::duration<double, std::milli>(dur1).count());
             }
 
-            // 获取关节位置直接返回
-            {
-                std::lock_guard<std::mutex> lock(command_mutex);
-                target_joint_pose = joint_position_cmd;
+            double gripper = gripper_position.load(std::memory_order_relaxed) / static_cast<double>(gripper_position_max);
+            fillSnapshot(robot_state, gripper, robot_snapshot);
+            state_snapshot.store(robot_snapshot);
+        };
+
+        // SDK 的控制线程由 SDK 创建，回调只在线程变化时记下线程号，由主线程设置其 CPU 亲和性与优先级，
+        // 亲和性设置与迁移不占用控制周期，也不计入周期与回调耗时的统计
+        pthread_t rt_thread = {};
+        bool rt_thread_known = false;
+        std::atomic<pid_t> rt_thread_id{0};
+        auto note_rt_thread = [&]() {
+            pthread_t self = pthread_self();
+            if (!rt_thread_known || !pthread_equal(self, rt_thread)) {
+                rt_thread = self;
+                rt_thread_known = true;
+                rt_thread_id.store(currentThreadId(), std::memory_order_release);
             }
-            return rokae::JointPosition(target_joint_pose);
         };
 
-        // 笛卡尔空间控制时的回调函数
-        std::function<rokae::CartesianPosition()> callback_cart = [&, rtCon]() {
-            std::chrono::steady_clock::time_point callback_start = std::chrono::steady_clock::now();
+        // 无锁读取已到计划执行时间的最新的完整命令
+        // 只接受当前控制模式期望的消息类型（见 acceptsCommand）：切换模式后 zmq_receiver 的命令记录仍保留旧的位姿与速度，
+        // 迟到的旧类型消息会把它们重新发布，这时保持上一条同类型的命令（切换时为当前位置）
+        Command applied_command = initial_command;
+        auto read_command = [&]() -> const Command& {
+            auto start = std::chrono::steady_clock::now();
+            if (command_playout.release(start)) {
+                const Command& released = command_playout.current();
+                if (acceptsCommand(mode.cmd_type, released.type)) {
+                    applied_command = released;
+                    command_apply_age_hist.record(start - released.sent_time);
+                    if (isVelocityCommand(released.type)) {
+                        command_supressed = false;
+                    }
+                } else {
+                    commands_wrong_mode.store(commands_wrong_mode.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "警告: 忽略与当前控制模式不符的命令");
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            command_read_hist.record(end - start);
+            command_age_hist.record(end - applied_command.recv_time);
+            return applied_command;
+        };
+
+        // 路点插值器，只由实时回调访问，以当前位置静止开始
+        WaypointUpsampler<7> joint_upsampler(upsampler_config, false);
+        WaypointUpsampler<3> pose_upsampler(upsampler_config, true);
+        {
+            double now = steadySeconds(std::chrono::steady_clock::now());
+            std::array<double, 3> p;
+            Quaternion q;
+            poseFromMatrix(target_pose_matrix, p, q);
+            joint_upsampler.reset(now, target_joint_pose);
+            pose_upsampler.reset(now, p, q);
+        }
 
-            double dt = 0.001; // 尽管回调间隔可能不是 1ms
+        // 将新到的路点交给插值器，路点时间为计划执行时间
+        auto read_waypoints = [&]() {
+            while (const Command* waypoint = waypoint_queue.peek()) {
+                double time = steadySeconds(waypoint->due_time);
+                if (waypoint->type == CmdType::joint_pose) {
+                    joint_upsampler.push(time, waypoint->joint_position);
+                } else if (waypoint->type == CmdType::pose_mat) {
+                    std::array<double, 3> p;
+                    Quaternion q;
+                    poseFromMatrix(waypoint->pose_matrix, p, q);
+                    pose_upsampler.push(time, p, q);
+                }
+                waypoint_queue.discard();
+            }
+        };
 
-            auto start1 = std::chrono::steady_clock::now();
-            // 获取当前的机器人状态：末端执行器姿态/轴角
-            // TODO 耗时可能比较长，切换为setControlLoop(useStateDataInLoop=True)和getStateData
-            std::array<double, 6> current_posture_flange = robot.posture(rokae::CoordinateType::flangeInBase, ec);
-            std::array<double, 16> current_mat_temp;
-            rokae::Utils::postureToTransArray(current_posture_flange, current_mat_temp);
-            std::array<double, 16> tcp_in_base;
-            multiplyMatrices<4>(current_mat_temp, tcp_frame, tcp_in_base);
-            std::array<double, 6> current_posture_temp;
-            extractXYZRPY(tcp_in_base, current_posture_temp);
-
-            std::array<double, 7> joint_pose_temp = robot.jointPos(ec);
-            auto now = std::chrono::steady_clock::now();
-            std::chrono::duration<double, std::milli> dur1 = now - start1;
-            if (dur1.count() > 1){
-                std::cout<< "robot.posture=" << dur1.count() << "ms" << std::endl;
-            }
-
-            // 更新共享的当前姿态
-            {
-                std::lock_guard<std::mutex> lock(pose_mutex);
-                current_posture = current_posture_temp;
-                current_joint = joint_pose_temp;
+        // 速度命令超时后返回 true，直到收到新的速度命令
+        auto velocity_timed_out = [&](std::chrono::steady_clock::time_point callback_start, const Command& command) {
+            auto time_since_last_msg = std::chrono::duration_cast<std::chrono::milliseconds>(callback_start - command.due_time);
+            if (time_since_last_msg > zmq_recv_timeout && !command_supressed) {
+                // 超时，设置速度为0并输出错误，开启 useVelocityOtg 时按加速度限制减速停下
+                command_supressed = true;
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn,
+                                      "警告: 未在 %.0f 毫秒内接收到 zmq 消息。将期望速度置为0。", zmq_recv_timeout.count());
             }
+            return command_supressed;
+        };
 
-            // 接收变换矩阵时直接返回
-            if (cmdType == CmdType::pose_mat){
-                {
-                    std::lock_guard<std::mutex> lock(command_mutex);
-                    target_pose_matrix = pose_matrix_cmd;
+        // 积分步长与速度跟踪统计，只由实时回调访问
+        CycleDt cycle_dt(0.001, 5);
+        VelocityTracker velocity_tracker;
+        // xyzrpy_vel 与 joint_vel 时期望速度的轨迹生成器
+        VelocityOtg<6> velocity_otg(max_twist_acceleration, max_twist_jerk);
+        VelocityOtg<7> joint_velocity_otg(max_joint_acceleration, max_joint_jerk);
+
+        // 动作块执行器，只由实时回调访问
+        ActionChunkExecutor<7> joint_executor(ensemble_config, false);
+        ActionChunkExecutor<3> pose_executor(ensemble_config, true);
+        {
+            std::array<double, 3> p;
+            Quaternion q;
+            poseFromMatrix(target_pose_matrix, p, q);
+            joint_executor.reset(target_joint_pose);
+            pose_executor.reset(p, q);
+        }
+
+        // 将新到的动作块交给执行器
+        auto read_chunks = [&]() {
+            while (const ActionChunk<7>* chunk = joint_chunk_queue.peek()) {
+                joint_executor.push(*chunk);
+                joint_chunk_queue.discard();
+            }
+            while (const ActionChunk<3>* chunk = pose_chunk_queue.peek()) {
+                pose_executor.push(*chunk);
+                pose_chunk_queue.discard();
+            }
+        };
+
+        // 安全限制，只由实时回调访问，以当前位置开始
+        SafetyFilter<safety_workspace.size()> safety_filter(safety_workspace, safety_limits, safety_counters);
+        safety_filter.reset(target_pose_matrix);
+        safety_filter.reset(target_joint_pose);
+        auto filter_joints = [&](std::array<double, 7>& joints) {
+            if (!useSafetyFilter) {
+                return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            bool limited = fk_enabled.load(std::memory_order_relaxed) ? safety_filter.filter(joints, tcp_frame)
+                                                                      : safety_filter.filter(joints);
+            safety_hist.record(std::chrono::steady_clock::now() - start);
+            return limited;
+        };
+        auto filter_pose = [&](std::array<double, 16>& pose) {
+            if (!useSafetyFilter) {
+                return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            bool limited = safety_filter.filter(pose);
+            safety_hist.record(std::chrono::steady_clock::now() - start);
+            if (limited) {
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "安全限制生效: tcp=[%.4f, %.4f, %.4f]",
+                                      pose[3], pose[7], pose[11]);
+            }
+            return limited;
+        };
+
+        // xyzrpy_vel 与 xyzrpy_vel_ik 时本周期的期望速度 [线速度, 角速度]，tcp_move 时为工具坐标系中的分量
+        // 超时后为 0，按最大速度与 scale 缩放，开启 useVelocityOtg 时限制加速度与加加速度
+        auto desired_twist = [&](std::chrono::steady_clock::time_point callback_start, const Command& command,
+                                 double scale, double dt) {
+            std::array<double, 6> velocity;
+            if (velocity_timed_out(callback_start, command)) {
+                velocity = std::array<double, 6>{0.0};
+            } else {
+                velocity = command.cartesian_velocity;
+            }
+
+            // TCP（法兰）坐标系的前、左、上分别是z、y、-x
+            std::array<double, 6> twist;
+            if (mode.tcp_move) {
+                twist = {-velocity[2], velocity[1], velocity[0], -velocity[5], velocity[4], velocity[3]};
+            } else {
+                twist = velocity;
+            }
+
+            // 计算缩放后的速度
+            for (int i = 0; i < 3; ++i) {
+                twist[i] *= max_linear_velocity * scale;
+                twist[i + 3] *= max_angular_velocity * scale;
+            }
+
+            // 限制加速度与加加速度
+            if (useVelocityOtg) {
+                twist = velocity_otg.update(twist, dt);
+            }
+            return twist;
+        };
+
+        // xyzrpy_vel_ik 时零空间保持的偏好关节姿态
+        std::array<double, 7> preferred_joint_pose = target_joint_pose;
+        // 雅可比矩阵，xyzrpy_vel_ik 与笛卡尔空间的奇异位形缩放共用
+        std::array<double, 42> jacobian_matrix;
+        std::array<double, 16> ik_flange;
+        std::array<double, 16> ik_tcp;
+
+        // 轴空间控制时的回调函数
+        std::function<rokae::JointPosition()> callback_joint = [&, rtCon]() {
+            std::chrono::steady_clock::time_point callback_start = std::chrono::steady_clock::now();
+            begin_tick(callback_start);
+            note_rt_thread();
+            rtAllocGuardArm();
+            read_state();
+
+            // 获取关节位置直接返回，开启插值时返回插值后的关节位置
+            const Command& command = read_command();
+            double measured_dt = cycle_dt.update(robot_state.stamp);
+            if (mode.cmd_type == CmdType::joint_vel) {
+                // 积分关节速度，从期望的关节位置开始
+                double dt = integratorDt == IntegratorDt::measured ? measured_dt : cycle_dt.period();
+                std::array<double, 7> joint_velocity = {0.0};
+                if (!velocity_timed_out(callback_start, command)) {
+                    for (std::size_t i = 0; i < joint_velocity.size(); ++i) {
+                        double v = std::fmax(-1.0, std::fmin(1.0, command.joint_velocity[i]));
+                        joint_velocity[i] = v * max_joint_velocity[i];
+                    }
+                }
+                if (useVelocityOtg) {
+                    joint_velocity = joint_velocity_otg.update(joint_velocity, dt);
+                }
+                for (std::size_t i = 0; i < target_joint_pose.size(); ++i) {
+                    target_joint_pose[i] += joint_velocity[i] * dt;
                 }
+            } else if (mode.cmd_type == CmdType::xyzrpy_vel_ik && !fk_enabled.load(std::memory_order_relaxed)) {
+                // 运行中正运动学比对失败，雅可比矩阵不再可信，停在当前目标，需要切换到其它模式继续
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::error, "错误: 运动学模型未通过比对，xyzrpy_vel_ik 停止运动");
+            } else if (mode.cmd_type == CmdType::xyzrpy_vel_ik) {
+                // 在期望（或实际）关节角度处求雅可比矩阵，把工具坐标系中的速度换到基坐标系、参考点从 tcp 换到法兰
+                double dt = integratorDt == IntegratorDt::measured ? measured_dt : cycle_dt.period();
+                std::array<double, 6> twist = desired_twist(callback_start, command, 1.0, dt);
+                if (!mode.desired_pose) {
+                    target_joint_pose = robot_state.joint_pos;
+                }
+                auto ik_start = std::chrono::steady_clock::now();
+                jacobian(target_joint_pose, jacobian_matrix, ik_flange);
+                multiplyTransforms(ik_flange, tcp_frame, ik_tcp);
+                std::array<double, 6> v;
+                for (int i = 0; i < 3; ++i) {
+                    if (mode.tcp_move) {
+                        v[i] = ik_tcp[i * 4] * twist[0] + ik_tcp[i * 4 + 1] * twist[1] + ik_tcp[i * 4 + 2] * twist[2];
+                        v[i + 3] = ik_tcp[i * 4] * twist[3] + ik_tcp[i * 4 + 1] * twist[4] + ik_tcp[i * 4 + 2] * twist[5];
+                    } else {
+                        v[i] = twist[i];
+                        v[i + 3] = twist[i + 3];
+                    }
+                }
+                // 法兰速度 = tcp 速度 + ω × (p_flange - p_tcp)
+                double rx = ik_flange[3] - ik_tcp[3];
+                double ry = ik_flange[7] - ik_tcp[7];
+                double rz = ik_flange[11] - ik_tcp[11];
+                v[0] += v[4] * rz - v[5] * ry;
+                v[1] += v[5] * rx - v[3] * rz;
+                v[2] += v[3] * ry - v[4] * rx;
+
+                std::array<double, 7> nullspace_velocity;
+                for (std::size_t i = 0; i < nullspace_velocity.size(); ++i) {
+                    nullspace_velocity[i] = nullspace_gain * (preferred_joint_pose[i] - target_joint_pose[i]);
+                }
+                std::array<double, 7> joint_velocity;
+                double w = dampedLeastSquares<7>(jacobian_matrix, v, nullspace_velocity, dls_config, joint_velocity);
+                // 超过关节最大速度时整体等比例缩小，保持末端运动方向
+                double ratio = 1.0;
+                for (std::size_t i = 0; i < joint_velocity.size(); ++i) {
+                    ratio = std::fmax(ratio, std::fabs(joint_velocity[i]) / max_joint_velocity[i]);
+                }
+                for (std::size_t i = 0; i < target_joint_pose.size(); ++i) {
+                    target_joint_pose[i] += joint_velocity[i] / ratio * dt;
+                }
+                jacobian_hist.record(std::chrono::steady_clock::now() - ik_start);
+                manipulability_now.store(w, std::memory_order_relaxed);
+                singularity_scale_now.store(1.0 / ratio, std::memory_order_relaxed);
+                if (ratio > 1.0) {
+                    singularity_scaled.store(singularity_scaled.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                }
+            } else if (mode.cmd_type == CmdType::joint_chunk) {
+                read_chunks();
+                joint_executor.sample(steadySeconds(callback_start), target_joint_pose);
+            } else if (useUpsampling) {
+                read_waypoints();
+                joint_upsampler.sample(steadySeconds(callback_start), target_joint_pose);
+            } else {
+                target_joint_pose = command.joint_position;
+            }
+            // 积分得到的目标也一起被限制，不会越过限位继续累积
+            if (filter_joints(target_joint_pose)) {
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "安全限制生效: 关节目标被限制");
+            }
+            std::copy(target_joint_pose.begin(), target_joint_pose.end(), joint_output.joints.begin());
+            end_tick(callback_start);
+            // 返回值由 SDK 的 JointPosition 拷贝出 std::vector，这次分配不在检查范围内
+            rtAllocGuardDisarm();
+            return joint_output;
+        };
+
+        // xyzrpy_vel 时目标姿态的四元数状态
+        OrientationIntegrator target_orientation;
+        target_orientation.reset(target_pose_matrix);
+        // pose_mat 与 pose_chunk 时上一周期返回的位姿，用于缩放步长
+        std::array<double, 16> last_pose_output = target_pose_matrix;
+
+        // 由实际关节角度计算可操作度，返回本周期笛卡尔速度与步长的缩放系数
+        std::array<double, 16> jacobian_flange;
+        auto singularity_scale = [&]() {
+            // 可操作度由 DH 模型计算，模型未通过比对时不缩放
+            if (!useSingularityScaling || !fk_enabled.load(std::memory_order_relaxed)) {
+                return 1.0;
+            }
+            auto start = std::chrono::steady_clock::now();
+            jacobian(robot_state.joint_pos, jacobian_matrix, jacobian_flange);
+            double w = manipulability<7>(jacobian_matrix);
+            double scale = singularityScale(w, singularity_scaling);
+            jacobian_hist.record(std::chrono::steady_clock::now() - start);
+            manipulability_now.store(w, std::memory_order_relaxed);
+            singularity_scale_now.store(scale, std::memory_order_relaxed);
+            if (scale < 1.0) {
+                singularity_scaled.store(singularity_scaled.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "接近奇异位形: 可操作度=%.4f 速度缩放=%.2f", w, scale);
+            }
+            return scale;
+        };
+
+        // 笛卡尔空间控制时的回调函数
+        std::function<rokae::CartesianPosition()> callback_cart = [&, rtCon]() {
+            std::chrono::steady_clock::time_point callback_start = std::chrono::steady_clock::now();
+            begin_tick(callback_start);
+            note_rt_thread();
+            rtAllocGuardArm();
+
+            read_state();
+            const Command& command = read_command();
+
+            // 回调间隔可能不是 1ms，measured 时按状态时间戳计算的周期数积分
+            double measured_dt = cycle_dt.update(robot_state.stamp);
+            double dt = integratorDt == IntegratorDt::measured ? measured_dt : cycle_dt.period();
+            double speed_scale = singularity_scale();
+
+            // 接收变换矩阵时直接返回，开启插值时返回插值后的变换矩阵，接收动作块时返回时间集成的结果
+            if (mode.cmd_type == CmdType::pose_mat || mode.cmd_type == CmdType::pose_chunk){
+                if (mode.cmd_type == CmdType::pose_chunk) {
+                    read_chunks();
+                    std::array<double, 3> p;
+                    Quaternion q;
+                    pose_executor.sample(steadySeconds(callback_start), p, q);
+                    poseToMatrix(p, q, target_pose_matrix);
+                } else if (useUpsampling) {
+                    read_waypoints();
+                    std::array<double, 3> p;
+                    Quaternion q;
+                    pose_upsampler.sample(steadySeconds(callback_start), p, q);
+                    poseToMatrix(p, q, target_pose_matrix);
+                } else {
+                    target_pose_matrix = command.pose_matrix;
+                }
+                if (speed_scale < 1.0) {
+                    // 从上一次的输出最多走缩放后的最大速度乘以 dt，姿态用 SLERP；插值器与动作块仍按自己的时钟前进，
+                    // 离开奇异区域后目标按安全限制的步长追上
+                    double max_step = speed_scale * max_linear_velocity * dt;
+                    double max_angle = speed_scale * max_angular_velocity * dt;
+                    std::array<double, 3> p, last_p;
+                    Quaternion q, last_q;
+                    poseFromMatrix(target_pose_matrix, p, q);
+                    poseFromMatrix(last_pose_output, last_p, last_q);
+                    double step = std::sqrt((p[0] - last_p[0]) * (p[0] - last_p[0]) + (p[1] - last_p[1]) * (p[1] - last_p[1]) +
+                                            (p[2] - last_p[2]) * (p[2] - last_p[2]));
+                    if (step > max_step) {
+                        for (std::size_t i = 0; i < 3; ++i) {
+                            p[i] = last_p[i] + max_step / step * (p[i] - last_p[i]);
+                        }
+                    }
+                    double angle = 2.0 * std::acos(std::fmin(1.0, std::fabs(quaternionDot(last_q, q))));
+                    if (angle > max_angle) {
+                        q = quaternionSlerp(last_q, q, max_angle / angle);
+                    }
+                    poseToMatrix(p, q, target_pose_matrix);
+                }
+                filter_pose(target_pose_matrix);
+                last_pose_output = target_pose_matrix;
+                end_tick(callback_start);
+                rtAllocGuardDisarm();
                 return rokae::CartesianPosition(target_pose_matrix);
             }
 
             // 使用实时查询到的位置作为位置变换起点
-            if(!useDesiredPose){
-                target_pose_matrix = tcp_in_base;
+            if(!mode.desired_pose){
+                target_pose_matrix = robot_state.tcp_in_base;
+                target_orientation.reset(target_pose_matrix);
             }
 
             curr_pos = {target_pose_matrix[3], target_pose_matrix[7], target_pose_matrix[11]};
@@ -464,36 +1419,10 @@ int main() {
                 target_pose_matrix[8], target_pose_matrix[9], target_pose_matrix[10]
             };
 
-            std::array<double, 6> velocity;
-            std::array<double, 3> linear_velocity;
-            std::array<double, 3> angular_velocity;
-            {
-                std::lock_guard<std::mutex> lock(command_mutex);
-                auto time_since_last_msg = std::chrono::duration_cast<std::chrono::milliseconds>(callback_start - last_message_time);
-                if (time_since_last_msg > zmq_recv_timeout && !command_supressed) {
-                    // 超时，设置速度为0并输出错误
-                    cartesian_velocity_cmd = std::array<double, 6>{0.0};
-                    command_supressed = true;
-                    std::cerr << "警告: 未在 " << zmq_recv_timeout.count() << " 毫秒内接收到 zmq 消息。将期望速度置为0。" << std::endl;
-                }
-
-                velocity = cartesian_velocity_cmd;
-            }
-
-            // TCP（法兰）坐标系的前、左、上分别是z、y、-x
-            if(useTCPMove){
-                linear_velocity = {-velocity[2], velocity[1], velocity[0]};
-                angular_velocity = {-velocity[5], velocity[4], velocity[3]};
-            } else {
-                linear_velocity = {velocity[0], velocity[1], velocity[2]};
-                angular_velocity = {velocity[3], velocity[4], velocity[5]};
-            }
-
-            // 计算缩放后的速度
-            for (int i = 0; i < 3; ++i) {
-                linear_velocity[i] *= max_linear_velocity;
-                angular_velocity[i] *= max_angular_velocity;
-            }
+            // 期望速度，接近奇异位形时进一步缩小
+            std::array<double, 6> twist = desired_twist(callback_start, command, speed_scale, dt);
+            std::array<double, 3> linear_velocity = {twist[0], twist[1], twist[2]};
+            std::array<double, 3> angular_velocity = {twist[3], twist[4], twist[5]};
 
             // 计算位置变化 (delta_position = linear_velocity * dt)
             std::array<double, 3> delta_position;
@@ -502,7 +1431,7 @@ int main() {
             }
 
             // 将delta_position从工具坐标系转换到基坐标系
-            if (useTCPMove) {
+            if (mode.tcp_move) {
                 std::array<double, 3> transformed_delta_position = {0.0, 0.0, 0.0};
                 for (int i = 0; i < 3; ++i) {
                     for (int j = 0; j < 3; ++j) {
@@ -525,7 +1454,7 @@ int main() {
             }
 
             // 将delta_rotation_vector从工具坐标系转换到基坐标系
-            if (useTCPMove) {
+            if (mode.tcp_move) {
                 std::array<double, 3> transformed_delta_rotation_vector = {0.0, 0.0, 0.0};
                 for (int i = 0; i < 3; ++i) {
                     for (int j = 0; j < 3; ++j) {
@@ -535,95 +1464,279 @@ int main() {
                 delta_rotation_vector = transformed_delta_rotation_vector;
             }
 
-            // 计算旋转角度和轴
-            double angle = std::sqrt(delta_rotation_vector[0] * delta_rotation_vector[0] +
-                                     delta_rotation_vector[1] * delta_rotation_vector[1] +
-                                     delta_rotation_vector[2] * delta_rotation_vector[2]);
-
-            std::array<double, 9> delta_rotation_matrix = {1, 0, 0,
-                                                           0, 1, 0,
-                                                           0, 0, 1};
-
-            if (angle > 1e-6) {
-                // 归一化旋转向量以得到旋转轴
-                std::array<double, 3> axis = {delta_rotation_vector[0] / angle,
-                                               delta_rotation_vector[1] / angle,
-                                               delta_rotation_vector[2] / angle};
-
-                // 使用罗德里格公式计算旋转矩阵
-                double c = std::cos(angle);
-                double s = std::sin(angle);
-                double t = 1 - c;
-                double x = axis[0];
-                double y = axis[1];
-                double z = axis[2];
-
-                delta_rotation_matrix = {
-                    t * x * x + c,     t * x * y - s * z, t * x * z + s * y,
-                    t * x * y + s * z, t * y * y + c,     t * y * z - s * x,
-                    t * x * z - s * y, t * y * z + s * x, t * z * z + c,
-                };
-            }
-
-            // 计算新的旋转矩阵: new_R = delta_R * current_R
-            std::array<double, 9> new_rotation_matrix = {0.0};
-            multiplyMatrices<3>(delta_rotation_matrix, current_rotation_matrix, new_rotation_matrix);
-
-            // 更新姿态矩阵中的旋转矩阵
-            target_pose_matrix[0] = new_rotation_matrix[0];
-            target_pose_matrix[1] = new_rotation_matrix[1];
-            target_pose_matrix[2] = new_rotation_matrix[2];
-            target_pose_matrix[4] = new_rotation_matrix[3];
-            target_pose_matrix[5] = new_rotation_matrix[4];
-            target_pose_matrix[6] = new_rotation_matrix[5];
-            target_pose_matrix[8] = new_rotation_matrix[6];
-            target_pose_matrix[9] = new_rotation_matrix[7];
-            target_pose_matrix[10] = new_rotation_matrix[8];
+            // 对比基坐标系下的指令速度与实际 tcp 速度
+            {
+                std::array<double, 3> commanded_linear, commanded_angular;
+                for (int i = 0; i < 3; ++i) {
+                    commanded_linear[i] = delta_position[i] / dt;
+                    commanded_angular[i] = delta_rotation_vector[i] / dt;
+                }
+                velocity_tracker.update(commanded_linear, commanded_angular, robot_state.tcp_in_base, measured_dt);
+                if (robot_state.cycle % 100 == 0) {
+                    tracking_summary.store(velocity_tracker.summary());
+                }
+            }
+
+            // 以四元数累积姿态，只在返回给 SDK 时写回矩阵
+            target_orientation.integrate(delta_rotation_vector);
+            target_orientation.toMatrix(target_pose_matrix);
+            // 积分得到的目标也一起被限制，不会越过工作空间继续累积
+            if (filter_pose(target_pose_matrix)) {
+                target_orientation.reset(target_pose_matrix);
+            }
 
             // 测量回调执行时间，打印日志
             #ifdef DEBUG
-            std::cout << "target_pose_matrix:" << std::endl;
             for (int i = 0; i < 4; ++i) {
-                for (int j = 0; j < 4; ++j) {
-                    std::cout << target_pose_matrix[i * 4 + j] << " ";
-                }
-                std::cout << std::endl;
+                logger.log(LogLevel::info, "target_pose_matrix[%.0f]: %.4f %.4f %.4f %.4f", i,
+                           target_pose_matrix[i * 4], target_pose_matrix[i * 4 + 1],
+                           target_pose_matrix[i * 4 + 2], target_pose_matrix[i * 4 + 3]);
             }
             std::chrono::steady_clock::time_point callback_end = std::chrono::steady_clock::now();
             std::chrono::duration<double, std::milli> callback_duration = callback_end - callback_start;
-            std::cout << "p=[" << curr_pos[0] << ", " << curr_pos[1] << ", " << curr_pos[2] << "] ";
-            std::cout << "dp=[" << delta_position[0] << ", " << delta_position[1] << ", " << delta_position[2] << "] ";
-            if(!useDesiredPose){
-                std::cout << "rdp=[" << curr_pos[0]-last_pos[0] << ", " << curr_pos[1]-last_pos[1] << ", " << curr_pos[2]-last_pos[2] << "] ";
+            logger.log(LogLevel::info, "p=[%.4f, %.4f, %.4f] dp=[%.6f, %.6f, %.6f] dt=%.3fms exe=%.4fms",
+                       curr_pos[0], curr_pos[1], curr_pos[2], delta_position[0], delta_position[1], delta_position[2],
+                       dt * 1000, callback_duration.count());
+            if(!mode.desired_pose){
+                logger.log(LogLevel::info, "rdp=[%.6f, %.6f, %.6f]",
+                           curr_pos[0] - last_pos[0], curr_pos[1] - last_pos[1], curr_pos[2] - last_pos[2]);
             }
-            std::cout << "dt=" << dt*1000 << "ms exe=" << callback_duration.count() << "ms" << std::endl;
             last_pos = curr_pos;
             #endif
 
+            end_tick(callback_start);
+            rtAllocGuardDisarm();
             return rokae::CartesianPosition(target_pose_matrix);
         };
 
-        if (cmdType == CmdType::joint_pose) {
-            rtCon->setControlLoop(callback_joint);
-        } else {
-            rtCon->setControlLoop(callback_cart);
+        if (useStateDataInLoop) {
+            // 状态数据由控制器每 1ms 推送，回调前由 SDK 更新
+            robot.startReceiveRobotState(std::chrono::milliseconds(1), robotStateFields());
+        }
+        auto set_control_loop = [&](const ControlMode& m) {
+            if (isJointCommand(m.cmd_type)) {
+                rtCon->setControlLoop(callback_joint, rt_placement.priority, useStateDataInLoop);
+            } else {
+                rtCon->setControlLoop(callback_cart, rt_placement.priority, useStateDataInLoop);
+            };
         };
+        set_control_loop(mode);
         rtCon->startLoop(false);
+        // 用过的控制模式，退出时打印对应的统计
+        std::array<bool, 7> used_modes = {false};
+        used_modes[static_cast<std::size_t>(mode.cmd_type)] = true;
+
+        // 切换控制模式：停止控制循环，以当前实际位置重新初始化所有目标，再按新模式重新启动
+        auto switch_mode = [&](const ControlMode& next, std::chrono::steady_clock::time_point request_time) {
+            if (next.cmd_type == CmdType::xyzrpy_vel_ik && !fk_enabled.load(std::memory_order_relaxed)) {
+                std::cerr << "运动学模型未通过比对，拒绝切换到 xyzrpy_vel_ik，保持 " << cmdTypeName(mode.cmd_type) << std::endl;
+                return;
+            }
+            auto stop_start = std::chrono::steady_clock::now();
+            rtCon->stopLoop();
+            rtCon->stopMove();
+            auto stop_end = std::chrono::steady_clock::now();
+
+            // 控制循环已停止，以下状态暂时只由主线程访问
+            RobotState current_state;
+            readRobotStateQuery(robot, tcp_frame, current_state, ec);
+            robot_state = current_state;
+            target_pose_matrix = current_state.tcp_in_base;
+            target_joint_pose = current_state.joint_pos;
+            preferred_joint_pose = target_joint_pose;
+            target_orientation.reset(target_pose_matrix);
+            last_pose_output = target_pose_matrix;
+            safety_filter.reset(target_pose_matrix);
+            safety_filter.reset(target_joint_pose);
+            velocity_otg.reset();
+            joint_velocity_otg.reset();
+            cycle_dt.restart();
+            velocity_tracker.restart();
+            double now = steadySeconds(stop_end);
+            std::array<double, 3> p;
+            Quaternion q;
+            poseFromMatrix(target_pose_matrix, p, q);
+            joint_upsampler.reset(now, target_joint_pose);
+            pose_upsampler.reset(now, p, q);
+            joint_executor.reset(target_joint_pose);
+            pose_executor.reset(p, q);
+            // 旧模式下未执行的命令全部丢弃，当前命令改为保持在当前位置，速度命令等收到新的消息后才生效
+            while (waypoint_queue.peek()) {
+                waypoint_queue.discard();
+            }
+            while (joint_chunk_queue.peek()) {
+                joint_chunk_queue.discard();
+            }
+            while (pose_chunk_queue.peek()) {
+                pose_chunk_queue.discard();
+            }
+            Command hold = command_playout.current();
+            hold.type = messageType(next.cmd_type);
+            hold.pose_matrix = target_pose_matrix;
+            hold.joint_position = target_joint_pose;
+            hold.cartesian_velocity = {0.0};
+            hold.joint_velocity = {0.0};
+            hold.recv_time = stop_end;
+            hold.due_time = stop_end;
+            command_playout.reset(hold);
+            applied_command = hold;
+            command_supressed = true;
+            last_callback_start = {};
+
+            mode = next;
+            active_cmd_type = mode.cmd_type;
+            used_modes[static_cast<std::size_t>(mode.cmd_type)] = true;
+            configure_mode(mode);
+            start_move(mode);
+            mode_switch_request = request_time;
+            mode_switch_pending = true;
+            set_control_loop(mode);
+            rtCon->startLoop(false);
+            auto start_end = std::chrono::steady_clock::now();
+            ++mode_switches;
+
+            std::chrono::duration<double, std::milli> queued = stop_start - request_time;
+            std::chrono::duration<double, std::milli> stopping = stop_end - stop_start;
+            std::chrono::duration<double, std::milli> starting = start_end - stop_end;
+            std::cout << "切换到 " << cmdTypeName(mode.cmd_type) << (mode.position_control ? " 位置控制" : " 阻抗控制")
+                      << ": 等待 " << queued.count() << "ms 停止 " << stopping.count() << "ms 启动 " << starting.count()
+                      << "ms ec=" << ec << std::endl;
+        };
+
+        // SDK 可能为每次 startLoop 创建新的控制线程，主线程发现新的线程号时设置它的调度
+        pid_t placed_rt_thread = 0;
+        auto place_rt_thread = [&]() {
+            pid_t tid = rt_thread_id.load(std::memory_order_acquire);
+            if (tid != 0 && tid != placed_rt_thread) {
+                applyThreadPlacement(tid, rt_placement, rt_placement_result);
+                placed_rt_thread = tid;
+            }
+        };
+
+        // 打印各线程实际生效的调度情况
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        place_rt_thread();
+        std::cout << "线程调度:" << std::endl;
+        printPlacement(rt_placement, rt_placement_result);
+        printPlacement(receiver_placement, receiver_placement_result);
+        printPlacement(sender_placement, sender_placement_result);
+        if (use_gripper) {
+            printPlacement(gripper_placement, gripper_placement_result);
+        }
 
         std::cout << "开始实时控制，按回车键停止..." << std::endl;
-        std::cin.get();
+        std::atomic<bool> stop_requested = false;
+        std::thread stdin_thread([&]() {
+            std::cin.get();
+            stop_requested = true;
+        });
+        while (!stop_requested) {
+            ControlMode next;
+            std::chrono::steady_clock::time_point request_time;
+            bool requested = false;
+            {
+                std::lock_guard<std::mutex> lock(mode_mutex);
+                if (mode_requested) {
+                    mode_requested = false;
+                    requested = true;
+                    next = requested_mode;
+                    request_time = mode_request_time;
+                }
+            }
+            if (requested) {
+                switch_mode(next, request_time);
+            }
+            place_rt_thread();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        stdin_thread.join();
 
         rtCon->stopLoop();
         std::cout << "控制循环已停止" << std::endl;
+        if (useStateDataInLoop) {
+            robot.stopReceiveRobotState();
+        }
+
+        // 打印回调各项延迟，可切换 useStateDataInLoop 对比状态读取耗时
+        std::cout << (useStateDataInLoop ? "[getStateData]" : "[posture/jointPos]") << std::endl;
+        period_hist.print("period");
+        state_read_hist.print("state read");
+        if (useAnalyticFk) {
+            fk_check.print("analytic fk vs sdk");
+        }
+        command_read_hist.print("command read");
+        compute_hist.print("compute");
+        callback_hist.print("callback");
+        command_age_hist.print("command age");
+        command_apply_age_hist.print("command apply age");
+        std::cout << "commands dropped: conflated=" << commands_conflated << " stale=" << commands_stale
+                  << " out_of_order=" << commands_out_of_order << " wrong_mode=" << commands_wrong_mode << std::endl;
+        if (useSafetyFilter) {
+            safety_hist.print("safety filter");
+            safety_counters.print("safety");
+        }
+        if (ik_checked > 0) {
+            std::cout << "reachability: checked=" << ik_checked << " unreachable=" << ik_unreachable
+                      << " clamped=" << ik_clamped << " skipped=" << ik_skipped << " searches=" << ik_searches
+                      << " search_unreachable=" << ik_search_unreachable << std::endl;
+            ik_check_hist.print("reachability check");
+        }
+        if (jacobian_hist.count() > 0) {
+            jacobian_hist.print("jacobian");
+            std::cout << "scaled cycles: " << singularity_scaled << std::endl;
+        }
+        playout_slack_hist.print("playout slack");
+        playout_late_hist.print("playout late");
+        if (mode_switches > 0) {
+            std::cout << "mode switches: " << mode_switches << std::endl;
+            mode_switch_hist.print("mode switch");
+        }
+        auto used = [&](CmdType type) { return used_modes[static_cast<std::size_t>(type)]; };
+        if (used(CmdType::xyzrpy_vel) || used(CmdType::joint_vel) || used(CmdType::xyzrpy_vel_ik)) {
+            std::cout << "cycle dt: missed=" << cycle_dt.missed() << " clamped=" << cycle_dt.clamped() << std::endl;
+        }
+        if (used(CmdType::xyzrpy_vel)) {
+            VelocityTracker::print("velocity tracking", velocity_tracker.summary());
+        }
+        if ((used(CmdType::xyzrpy_vel) || used(CmdType::xyzrpy_vel_ik)) && useVelocityOtg) {
+            velocity_otg.print("velocity otg");
+        }
+        if (used(CmdType::joint_vel) && useVelocityOtg) {
+            joint_velocity_otg.print("joint velocity otg");
+        }
+        if (useUpsampling && used(CmdType::joint_pose)) {
+            WaypointUpsampler<7>::print("joint upsampler", joint_upsampler.stats());
+        }
+        if (useUpsampling && used(CmdType::pose_mat)) {
+            WaypointUpsampler<3>::print("pose upsampler", pose_upsampler.stats());
+        }
+        if (used(CmdType::joint_chunk)) {
+            ActionChunkExecutor<7>::print("joint chunks", joint_executor.stats());
+        }
+        if (used(CmdType::pose_chunk)) {
+            ActionChunkExecutor<3>::print("pose chunks", pose_executor.stats());
+        }
+        command_playout.print("command playout");
+        state_snapshot.print("state snapshot");
+        rtAllocGuardPrint("rt alloc guard");
 
         running = false;
+        receiver_wakeup.notify();
         zmq_receiver_thread.join();
         zmq_sender_thread.join();
+        // zmq 线程退出前仍可能写日志，join 之后再停止日志线程
+        logger.stop();
+        logger.printStats("logger");
 
         robot.setPowerState(false, ec); // TODO 无法下电
     } catch (const std::exception &e) {
         std::cerr << "捕获异常: " << e.what() << " ec=" << ec << std::endl;
     }
 
+    running = false;
+    if (gripper_thread.joinable()) {
+        gripper_thread.join();
+    }
+
     return 0;
 }
@@ -10,6 +10,12 @@
 #include "json.hpp"
 #include "rokae/robot.h"
 #include "rokae/utility.h"
+#include "rt_state.h"
+#include "rt_timing.h"
+#include "rt_alloc_guard.h"
+#include "rt_thread.h"
+#include "async_logger.h"
+#include "cycle_dt.h"
 
 using json = nlohmann::json;
 
@@ -29,6 +35,10 @@ int main() {
     const bool useDesiredPose = true;
     // 解释命令为相对于工具坐标系的移动，否则相对于基座标系（仅在xyzrpy_vel时有效）
     const bool useTCPMove = false;
+    // （仅在xyzrpy_vel时有效）积分步长：fixed 固定为 1ms，measured 由控制周期时间戳计算并计入丢失的周期
+    const IntegratorDt integratorDt = IntegratorDt::measured;
+    // 在回调中使用控制器每周期推送的状态数据（getStateData），否则每周期调用 robot.posture()/jointPos() 查询
+    const bool useStateDataInLoop = true;
 
     const CmdType cmdType = CmdType:: pose_mat;
 
@@ -37,8 +47,26 @@ int main() {
     const double max_angular_velocity = 0.16;  // 最大角速度 (弧度/秒)
     // TODO 为什么调小它反而变快了？？？？
 
+    // 各线程的 SCHED_FIFO 优先级（0 为普通调度）与绑定的 CPU，没有 CAP_SYS_NICE 时退回普通调度继续运行
+    const ThreadPlacement rt_placement = {"rt loop", 90, {2}};
+    const ThreadPlacement receiver_placement = {"receiver", 80, {3}};
+    const ThreadPlacement sender_placement = {"sender", 10, {1}};
+    // 启动时锁定内存，避免运行中发生缺页
+    const bool lock_memory = true;
+    PlacementResult rt_placement_result, receiver_placement_result, sender_placement_result;
+
     std::cout.setf(std::ios::showpoint);
     std::cout.precision(4);
+    // 实时回调中的日志只入队，由后台线程格式化输出
+    AsyncLogger logger;
+    logger.start();
+
+    if (lock_memory) {
+        int err = lockProcessMemory();
+        if (err) {
+            std::cerr << "警告: mlockall 失败: " << std::strerror(err) << "，继续运行但可能发生缺页" << std::endl;
+        }
+    }
 
     std::error_code ec;
 
@@ -116,7 +144,7 @@ int main() {
         std::array<double, 3> linear_velocity_cmd = {0.0, 0.0, 0.0};    // [vx, vy, vz]
         std::array<double, 3> angular_velocity_cmd = {0.0, 0.0, 0.0};   // [wx, wy, wz]
         std::array<double, 16> pose_matrix_cmd = {0.0};
-        std::vector<double> joint_position_cmd;
+        std::array<double, 7> joint_position_cmd = {0.0};
         bool command_supressed = false; // 用于暂停控制
 
         // 跟踪最后一次接收到 zmq 消息的时间
@@ -130,6 +158,7 @@ int main() {
 
         // ZeroMQ 订阅线程接收期望的速度
         auto zmq_receiver = [&]() {
+            applyThreadPlacement(receiver_placement, receiver_placement_result);
             zmq::context_t context(1);
             zmq::socket_t subscriber(context, ZMQ_SUB);
             subscriber.connect(zmq_recv_addr);
@@ -176,8 +205,7 @@ int main() {
                         joint_position = msg_json["joint_position"].get<std::array<double, 7>>();
                         {
                             std::lock_guard<std::mutex> lock(command_mutex);
-                            joint_position_cmd.clear();
-                            std::copy(joint_position.begin(), joint_position.end(), std::back_inserter(joint_position_cmd));
+                            joint_position_cmd = joint_position;
                             command_supressed = true;
                             last_message_time = current_time;
                         }
@@ -190,6 +218,7 @@ int main() {
 
         // ZeroMQ 发布者线程发送当前末端位置
         auto zmq_sender = [&]() {
+            applyThreadPlacement(sender_placement, sender_placement_result);
             zmq::context_t context(1);
             zmq::socket_t publisher(context, ZMQ_PUB);
             publisher.bind("tcp://localhost:5556"); // 根据需要调整地址和端口
@@ -248,10 +277,11 @@ int main() {
         rokae::Utils::postureToTransArray(current_posture, target_pose_matrix);
         pose_matrix_cmd = target_pose_matrix;
 
-        std::vector<double> target_joint_pose;
+        // joint_output 预先分配好 7 个关节，回调中只原地拷贝
         current_joint = robot.jointPos(ec);
-        std::copy(current_joint.begin(), current_joint.end(), std::back_inserter(target_joint_pose));
+        std::array<double, 7> target_joint_pose = current_joint;
         joint_position_cmd = target_joint_pose;
+        rokae::JointPosition joint_output(target_joint_pose.size());
 
         std::thread zmq_sender_thread(zmq_sender);
         std::thread zmq_receiver_thread(zmq_receiver);
@@ -268,60 +298,74 @@ int main() {
         }
         target_pose_matrix = tcp_in_base;
 
-        // 轴空间控制时的回调函数
-        std::function<rokae::JointPosition(void)> callback_joint = [&, rtCon]() -> rokae::JointPosition {
+        // 每个周期的机器人状态与回调耗时统计，回调外预分配
+        RobotState robot_state;
+        DurationStats state_read_time;
+        DurationStats callback_time;
+
+        // 读取当前的机器人状态并更新共享的当前姿态
+        auto read_state = [&]() {
             auto start1 = std::chrono::steady_clock::now();
-            // 获取当前的机器人状态：末端执行器姿态/轴角
-            // TODO 耗时可能比较长，切换为setControlLoop(useStateDataInLoop=True)和getStateData
-            std::array<double, 6> current_posture_local = robot.posture(rokae::CoordinateType::flangeInBase, ec);
-            std::array<double, 7> joint_pose_local = robot.jointPos(ec);
-            auto now = std::chrono::steady_clock::now();
-            std::chrono::duration<double, std::milli> dur1 = now - start1;
-            if (dur1.count() > 1){
-                std::cout<< "robot.posture=" << dur1.count() << "ms" << std::endl;
+            if (useStateDataInLoop) {
+                readRobotStateInLoop(robot, tcp_frame, robot_state);
+            } else {
+                readRobotStateQuery(robot, tcp_frame, robot_state, ec);
             }
-            // 更新共享的当前姿态
+            auto dur1 = std::chrono::steady_clock::now() - start1;
+            state_read_time.add(dur1);
+            if (dur1 > std::chrono::milliseconds(1)){
+                logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn, "robot state read=%.3fms",
+                                      std::chrono::duration<double, std::milli>(dur1).count());
+            }
+
             {
-                current_posture = current_posture_local;
-                current_joint = joint_pose_local;
+                std::lock_guard<std::mutex> lock(pose_mutex);
+                current_posture = robot_state.tcp_posture;
+                current_joint = robot_state.joint_pos;
+            }
+        };
+
+        // SDK 的控制线程由 SDK 创建，在第一次回调时设置其 CPU 亲和性（优先级同时交给 setControlLoop）
+        bool rt_thread_placed = false;
+        auto place_rt_thread = [&]() {
+            if (!rt_thread_placed) {
+                applyThreadPlacement(rt_placement, rt_placement_result);
+                rt_thread_placed = true;
             }
+        };
+
+        // 轴空间控制时的回调函数
+        std::function<rokae::JointPosition(void)> callback_joint = [&, rtCon]() -> rokae::JointPosition {
+            auto callback_start = std::chrono::steady_clock::now();
+            place_rt_thread();
+            rtAllocGuardArm();
+            read_state();
 
             {
+                std::lock_guard<std::mutex> lock(command_mutex);
                 target_joint_pose = joint_position_cmd;
             }
-            std::cout << target_joint_pose[3];
-            std::cout << std::endl;
-            return rokae::JointPosition(target_joint_pose);
+            std::copy(target_joint_pose.begin(), target_joint_pose.end(), joint_output.joints.begin());
+            logger.logRateLimited(std::chrono::milliseconds(100), LogLevel::info, "target_joint_pose[3]=%.4f", target_joint_pose[3]);
+            callback_time.add(std::chrono::steady_clock::now() - callback_start);
+            // 返回值由 SDK 的 JointPosition 拷贝出 std::vector，这次分配不在检查范围内
+            rtAllocGuardDisarm();
+            return joint_output;
         };
 
+        // 积分步长，只由实时回调访问
+        CycleDt cycle_dt(0.001, 5);
+
         // 笛卡尔空间控制时的回调函数
         std::function<rokae::CartesianPosition(void)> callback_cart = [&, rtCon]() -> rokae::CartesianPosition {
             auto callback_start = std::chrono::steady_clock::now();
+            place_rt_thread();
+            rtAllocGuardArm();
+            read_state();
 
-            // 计算时间步长，避免过大值
-            // std::chrono::duration<double> elapsed = callback_start - last_time;
-            // double dt = elapsed.count();
-            // dt = std::min(dt, 0.002);
-            // last_time = callback_start;
-
-            double dt = 0.001;
-
-            auto start1 = std::chrono::steady_clock::now();
-            // 获取当前的机器人状态：末端执行器姿态/轴角
-            // TODO 耗时可能比较长，切换为setControlLoop(useStateDataInLoop=True)和getStateData
-            std::array<double, 6> current_posture_local = robot.posture(rokae::CoordinateType::flangeInBase, ec);
-            std::array<double, 7> joint_pose_local = robot.jointPos(ec);
-            auto now = std::chrono::steady_clock::now();
-            std::chrono::duration<double, std::milli> dur1 = now - start1;
-            if (dur1.count() > 1){
-                std::cout<< "robot.posture=" << dur1.count() << "ms" << std::endl;
-            }
-            // 更新共享的当前姿态
-            {
-                std::lock_guard<std::mutex> lock(pose_mutex);
-                current_posture = current_posture_local;
-                current_joint = joint_pose_local;
-            }
+            // 计算时间步长，按状态时间戳取整为周期数并限制最大值
+            double measured_dt = cycle_dt.update(robot_state.stamp);
+            double dt = integratorDt == IntegratorDt::measured ? measured_dt : cycle_dt.period();
 
             // 接收tcp变换矩阵时直接返回
             if (cmdType == CmdType::pose_mat){
@@ -329,12 +373,15 @@ int main() {
                     std::lock_guard<std::mutex> lock(command_mutex);
                     target_pose_matrix = pose_matrix_cmd;
                 }
+                callback_time.add(std::chrono::steady_clock::now() - callback_start);
+                // 返回值构造 SDK 的 CartesianPosition，这次分配不在检查范围内
+                rtAllocGuardDisarm();
                 return rokae::CartesianPosition(target_pose_matrix);
             }
 
             // 使用实时查询到的位置作为运动起点
             if(!useDesiredPose){
-                rokae::Utils::postureToTransArray(current_posture_local, target_pose_matrix);
+                target_pose_matrix = robot_state.tcp_in_base;
             }
 
             curr_pos = {target_pose_matrix[3], target_pose_matrix[7], target_pose_matrix[11]};
@@ -356,7 +403,8 @@ int main() {
                     linear_velocity_cmd = {0.0, 0.0, 0.0};
                     angular_velocity_cmd = {0.0, 0.0, 0.0};
                     command_supressed = true;
-                    std::cerr << "警告: 未在 " << timeout_duration.count() << " 毫秒内接收到 ZeroMQ 消息。将期望速度置为0。" << std::endl;
+                    logger.logRateLimited(std::chrono::seconds(1), LogLevel::warn,
+                                          "警告: 未在 %.0f 毫秒内接收到 ZeroMQ 消息。将期望速度置为0。", timeout_duration.count());
                 }
 
                 linear_velocity = linear_velocity_cmd;
@@ -479,26 +527,51 @@ int main() {
             // std::cout << "p=[" << curr_pos[0] << ", " << curr_pos[1] << ", " << curr_pos[2] << "] "
             // << "dp=[" << delta_position[0] << ", " << delta_position[1] << ", " << delta_position[2] << "] ";
             if(!useDesiredPose){
-                std::cout << "rdp=[" << curr_pos[0]-last_pos[0] << ", " << curr_pos[1]-last_pos[1] << ", " << curr_pos[2]-last_pos[2] << "] ";
+                logger.logRateLimited(std::chrono::milliseconds(100), LogLevel::info, "rdp=[%.6f, %.6f, %.6f]",
+                                      curr_pos[0] - last_pos[0], curr_pos[1] - last_pos[1], curr_pos[2] - last_pos[2]);
             }
             // std::cout << "dt=" << dt*1000 << "ms exe=" << callback_duration.count() << "ms" << std::endl;
             last_pos = curr_pos;
 
+            callback_time.add(callback_end - callback_start);
+            rtAllocGuardDisarm();
             return rokae::CartesianPosition(target_pose_matrix);
         };
 
+        if (useStateDataInLoop) {
+            // 状态数据由控制器每 1ms 推送，回调前由 SDK 更新
+            robot.startReceiveRobotState(std::chrono::milliseconds(1), robotStateFields());
+        }
         if (cmdType == CmdType::joint_pose) {
-            rtCon->setControlLoop(callback_joint);
+            rtCon->setControlLoop(callback_joint, rt_placement.priority, useStateDataInLoop);
         } else {
-            rtCon->setControlLoop(callback_cart);
+            rtCon->setControlLoop(callback_cart, rt_placement.priority, useStateDataInLoop);
         };
         rtCon->startLoop(false);
 
+        // 打印各线程实际生效的调度情况
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::cout << "线程调度:" << std::endl;
+        printPlacement(rt_placement, rt_placement_result);
+        printPlacement(receiver_placement, receiver_placement_result);
+        printPlacement(sender_placement, sender_placement_result);
+
         std::cout << "开始实时控制，按回车键停止..." << std::endl;
         std::cin.get();
 
         rtCon->stopLoop();
         std::cout << "控制循环已停止" << std::endl;
+        if (useStateDataInLoop) {
+            robot.stopReceiveRobotState();
+        }
+
+        // 打印状态读取与回调的耗时，可切换 useStateDataInLoop 对比
+        std::cout << (useStateDataInLoop ? "[getStateData]" : "[posture/jointPos]") << std::endl;
+        state_read_time.print("state read");
+        callback_time.print("callback");
+        rtAllocGuardPrint("rt alloc guard");
+        logger.stop();
+        logger.printStats("logger");
 
         running = false;
         zmq_receiver_thread.join();
@@ -0,0 +1,737 @@
+#include <iostream>
+#include <cmath>
+#include <array>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <ctime>
+#include <zmq.hpp>
+#include "pose_utils.h"
+#include "rotation.h"
+#include "kinematics.h"
+#include "ik_service.h"
+#include "safety_filter.h"
+#include "spsc_queue.h"
+#include "latency_histogram.h"
+#include "wakeup_fd.h"
+#include "wire_format.h"
+#include "json_command.h"
+#include "json_arena.h"
+#include "rt_alloc_guard.h"
+#include "json.hpp"
+
+// 各模块的性能测试，不需要连接机器人
+// 用法: benchmark [模块名 ...]，不带参数时运行全部
+
+
+template <class F>
+double nsPerCall(std::size_t n, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+        f(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+// 每次调用当前线程的平均 malloc 次数，benchmark 总是定义 RT_ALLOC_GUARD
+template <class F>
+double mallocsPerCall(std::size_t n, F&& f) {
+    uint64_t before = rtAllocGuardMallocs();
+    rtAllocGuardArm();
+    for (std::size_t i = 0; i < n; ++i) {
+        f(i);
+    }
+    rtAllocGuardDisarm();
+    return static_cast<double>(rtAllocGuardMallocs() - before) / n;
+}
+
+// ||R * R^T - I||_F，衡量旋转矩阵偏离 SO(3) 的程度
+double orthonormalityError(const std::array<double, 16>& T) {
+    double err = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            double dot = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                dot += T[i * 4 + k] * T[j * 4 + k];
+            }
+            double e = dot - (i == j ? 1.0 : 0.0);
+            err += e * e;
+        }
+    }
+    return std::sqrt(err);
+}
+
+// 原 callback_cart 中的做法：罗德里格公式得到增量矩阵，再与当前旋转矩阵相乘，不做正交化
+void rodriguesStep(const std::array<double, 3>& delta_rotation_vector, std::array<double, 16>& target_pose_matrix) {
+    std::array<double, 9> current_rotation_matrix = {
+        target_pose_matrix[0], target_pose_matrix[1], target_pose_matrix[2],
+        target_pose_matrix[4], target_pose_matrix[5], target_pose_matrix[6],
+        target_pose_matrix[8], target_pose_matrix[9], target_pose_matrix[10]
+    };
+    double angle = std::sqrt(delta_rotation_vector[0] * delta_rotation_vector[0] +
+                             delta_rotation_vector[1] * delta_rotation_vector[1] +
+                             delta_rotation_vector[2] * delta_rotation_vector[2]);
+    std::array<double, 9> delta_rotation_matrix = {1, 0, 0,
+                                                   0, 1, 0,
+                                                   0, 0, 1};
+    if (angle > 1e-6) {
+        std::array<double, 3> axis = {delta_rotation_vector[0] / angle,
+                                      delta_rotation_vector[1] / angle,
+                                      delta_rotation_vector[2] / angle};
+        double c = std::cos(angle);
+        double s = std::sin(angle);
+        double t = 1 - c;
+        double x = axis[0];
+        double y = axis[1];
+        double z = axis[2];
+        delta_rotation_matrix = {
+            t * x * x + c,     t * x * y - s * z, t * x * z + s * y,
+            t * x * y + s * z, t * y * y + c,     t * y * z - s * x,
+            t * x * z - s * y, t * y * z + s * x, t * z * z + c,
+        };
+    }
+    std::array<double, 9> new_rotation_matrix = {0.0};
+    multiplyMatrices<3>(delta_rotation_matrix, current_rotation_matrix, new_rotation_matrix);
+    target_pose_matrix[0] = new_rotation_matrix[0];
+    target_pose_matrix[1] = new_rotation_matrix[1];
+    target_pose_matrix[2] = new_rotation_matrix[2];
+    target_pose_matrix[4] = new_rotation_matrix[3];
+    target_pose_matrix[5] = new_rotation_matrix[4];
+    target_pose_matrix[6] = new_rotation_matrix[5];
+    target_pose_matrix[8] = new_rotation_matrix[6];
+    target_pose_matrix[9] = new_rotation_matrix[7];
+    target_pose_matrix[10] = new_rotation_matrix[8];
+}
+
+// 模拟 1 小时 1kHz 遥操作的姿态积分，对比耗时与漂移
+void benchRotation() {
+    const std::size_t steps = 3600 * 1000;
+    const std::array<double, 16> identity = {1, 0, 0, 0,
+                                             0, 1, 0, 0,
+                                             0, 0, 1, 0,
+                                             0, 0, 0, 1};
+    // 0.1 rad/s 与 2 rad/s 的角速度在 1ms 内的转角，前者走小角度分支
+    for (double rate : {0.1, 2.0}) {
+        // 预先算好一段变化的角速度，避免测到 sin/cos 的开销
+        static std::array<std::array<double, 3>, 4096> table;
+        for (std::size_t i = 0; i < table.size(); ++i) {
+            double t = i * 1e-3;
+            table[i] = {rate * 1e-3 * std::cos(7.0 * t), rate * 1e-3 * std::sin(3.0 * t), rate * 0.5e-3};
+        }
+        auto rotvec = [](std::size_t i) -> const std::array<double, 3>& { return table[i & (table.size() - 1)]; };
+
+        std::array<double, 16> old_pose = identity;
+        double old_ns = nsPerCall(steps, [&](std::size_t i) { rodriguesStep(rotvec(i), old_pose); });
+
+        std::array<double, 16> new_pose = identity;
+        OrientationIntegrator integrator;
+        integrator.reset(new_pose);
+        double new_ns = nsPerCall(steps, [&](std::size_t i) {
+            integrator.integrate(rotvec(i));
+            integrator.toMatrix(new_pose);
+        });
+
+        std::cout << "rotation " << rate << "rad/s x " << steps << " steps: "
+                  << "rodrigues+matmul " << old_ns << "ns/step err=" << orthonormalityError(old_pose) << ", "
+                  << "quaternion " << new_ns << "ns/step err=" << orthonormalityError(new_pose) << std::endl;
+    }
+}
+
+// 按 DH 参数逐个构造 4×4 矩阵再用 multiplyMatrices<4> 连乘，作为对照
+void dhChainReference(const std::array<double, 7>& q, std::array<double, 16>& flange_in_base) {
+    flange_in_base = {1, 0, 0, 0,
+                      0, 1, 0, 0,
+                      0, 0, 1, 0,
+                      0, 0, 0, 1};
+    for (std::size_t i = 0; i < 7; ++i) {
+        const DhRow& row = XMateEr7Pro::kDh[i];
+        double c = std::cos(q[i] + row.offset);
+        double s = std::sin(q[i] + row.offset);
+        double ca = row.cos_alpha;
+        double sa = row.sin_alpha;
+        std::array<double, 16> A = {c, -s * ca, s * sa,  row.a * c,
+                                    s, c * ca,  -c * sa, row.a * s,
+                                    0, sa,      ca,      row.d,
+                                    0, 0,       0,       1};
+        std::array<double, 16> product;
+        multiplyMatrices<4>(flange_in_base, A, product);
+        flange_in_base = product;
+    }
+}
+
+// 由关节角度得到 tcp 的 [x, y, z, roll, pitch, yaw]：DH 矩阵连乘与展开的正运动学对比耗时与一致性
+void benchFk() {
+    const std::size_t n = 2000000;
+    const std::array<double, 16> tcp_frame = {1, 0, 0, 0,
+                                              0, 1, 0, 0,
+                                              0, 0, 1, 0.2,
+                                              0, 0, 0, 1};
+    // 预先生成一组关节角度，覆盖各关节 ±2.5 弧度
+    static std::array<std::array<double, 7>, 4096> table;
+    uint64_t seed = 12345;
+    for (auto& q : table) {
+        for (auto& qi : q) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            qi = ((seed >> 11) * (1.0 / 9007199254740992.0) - 0.5) * 5.0;
+        }
+    }
+    auto joints = [](std::size_t i) -> const std::array<double, 7>& { return table[i & (table.size() - 1)]; };
+
+    double max_position = 0.0;
+    double max_rotation = 0.0;
+    for (const auto& q : table) {
+        std::array<double, 16> ref, fk;
+        dhChainReference(q, ref);
+        forwardKinematics(q, fk);
+        for (std::size_t k = 0; k < 12; ++k) {
+            double e = std::fabs(ref[k] - fk[k]);
+            if (k % 4 == 3) {
+                max_position = std::fmax(max_position, e);
+            } else {
+                max_rotation = std::fmax(max_rotation, e);
+            }
+        }
+    }
+    std::array<double, 16> zero_pose;
+    forwardKinematics({0, 0, 0, 0, 0, 0, 0}, zero_pose);
+
+    std::array<double, 6> xyzrpy;
+    double sink = 0.0;
+    double ref_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 16> flange_in_base, tcp_in_base;
+        dhChainReference(joints(i), flange_in_base);
+        multiplyMatrices<4>(flange_in_base, tcp_frame, tcp_in_base);
+        extractXYZRPY(tcp_in_base, xyzrpy);
+        sink += xyzrpy[0];
+    });
+    double flange_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 16> flange_in_base;
+        forwardKinematics(joints(i), flange_in_base);
+        sink += flange_in_base[3];
+    });
+    double tcp_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 16> tcp_in_base;
+        forwardKinematicsTcp(joints(i), tcp_frame, tcp_in_base);
+        extractXYZRPY(tcp_in_base, xyzrpy);
+        sink += xyzrpy[0];
+    });
+    double jacobian_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 42> J;
+        std::array<double, 16> flange_in_base;
+        jacobian(joints(i), J, flange_in_base);
+        sink += manipulability<7>(J);
+    });
+    const std::array<double, 6> twist = {0.05, 0.02, -0.03, 0.0, 0.0, 0.1};
+    const DlsConfig dls_config;
+    double dls_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 42> J;
+        std::array<double, 16> flange_in_base;
+        const std::array<double, 7>& q = joints(i);
+        jacobian(q, J, flange_in_base);
+        std::array<double, 7> z, dq;
+        for (std::size_t k = 0; k < 7; ++k) {
+            z[k] = -q[k];
+        }
+        sink += dampedLeastSquares<7>(J, twist, z, dls_config, dq) + dq[0];
+    });
+
+    std::cout << "fk x " << n << ": dh chain+matmul+rpy " << ref_ns << "ns/call, "
+              << "flange " << flange_ns << "ns/call, flange+tcp+rpy " << tcp_ns << "ns/call, "
+              << "jacobian+manipulability " << jacobian_ns << "ns/call, jacobian+dls " << dls_ns << "ns/call" << std::endl;
+    std::cout << "fk vs dh chain: max position diff=" << max_position << "m max rotation diff=" << max_rotation
+              << ", zero pose z=" << zero_pose[11] << "m (sink " << sink << ")" << std::endl;
+}
+
+// 逆解可达性检查的吞吐量：可达目标为随机关节角度的正运动学结果，不可达目标把位置推到 2m 外
+// 分别测单个目标逐个检查（初值为固定的初始姿态）与整批并行检查
+void benchIk() {
+    const std::size_t reachable_count = 512;
+    const std::size_t unreachable_count = 64;
+    const std::array<double, 7> home = {0, M_PI / 6, 0, M_PI / 3, 0, M_PI / 2, 0};
+    std::vector<std::array<double, 16>> targets;
+    uint64_t seed = 54321;
+    auto uniform = [&]() {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (seed >> 11) * (1.0 / 9007199254740992.0);
+    };
+    for (std::size_t i = 0; i < reachable_count + unreachable_count; ++i) {
+        std::array<double, 7> q;
+        for (std::size_t k = 0; k < 7; ++k) {
+            // 避开限位附近，保证随机姿态本身在限位内
+            q[k] = 0.9 * (XMateEr7Pro::kJointLower[k] + uniform() * (XMateEr7Pro::kJointUpper[k] - XMateEr7Pro::kJointLower[k]));
+        }
+        std::array<double, 16> T;
+        forwardKinematics(q, T);
+        if (i >= reachable_count) {
+            double r = std::sqrt(T[3] * T[3] + T[7] * T[7]) + 1e-9;
+            T[3] *= 2.0 / r;
+            T[7] *= 2.0 / r;
+        }
+        targets.push_back(T);
+    }
+
+    const IkConfig config;
+    // 调用线程之外的工作线程数：0，以及占满所有核
+    std::vector<std::size_t> worker_counts = {0};
+    if (std::thread::hardware_concurrency() > 1) {
+        worker_counts.push_back(std::thread::hardware_concurrency() - 1);
+    }
+    for (std::size_t workers : worker_counts) {
+        ReachabilityChecker<XMateEr7Pro> checker(config, workers);
+        std::vector<IkResult> results(targets.size());
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < targets.size(); ++i) {
+            checker.check(targets[i], home, results[i]);
+        }
+        double single_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::size_t single_reachable = 0, single_false_negative = 0;
+        uint64_t seeds_tried = 0;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            single_reachable += results[i].reachable;
+            single_false_negative += i < reachable_count && !results[i].reachable;
+            seeds_tried += results[i].seeds_tried;
+        }
+
+        start = std::chrono::steady_clock::now();
+        checker.check(targets.data(), targets.size(), home, results.data());
+        double batch_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::size_t batch_reachable = 0;
+        for (const auto& r : results) {
+            batch_reachable += r.reachable;
+        }
+
+        std::cout << "ik " << checker.threads() << " threads, " << reachable_count << " reachable + " << unreachable_count
+                  << " unreachable targets: single " << targets.size() / single_s << " targets/s ("
+                  << single_reachable << " reachable, " << single_false_negative << " missed, "
+                  << static_cast<double>(seeds_tried) / targets.size() << " seeds/target), batch "
+                  << targets.size() / batch_s << " targets/s (" << batch_reachable << " reachable)" << std::endl;
+    }
+
+    // zmq_receiver 的流式检查：每个目标只从上一个目标的解迭代，沿一条 1kHz 的关节轨迹；不可达目标为单个初值迭代满的上限
+    const std::size_t stream_count = 2000;
+    std::vector<std::array<double, 16>> stream(stream_count);
+    for (std::size_t i = 0; i < stream_count; ++i) {
+        std::array<double, 7> q = home;
+        for (std::size_t k = 0; k < 7; ++k) {
+            q[k] += 0.3 * std::sin(2.0 * M_PI * 0.5 * i * 1e-3 + k);
+        }
+        forwardKinematics(q, stream[i]);
+    }
+    IkResult result;
+    std::array<double, 7> warm = home;
+    std::size_t converged = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& target : stream) {
+        if (solveIkFromSeed<XMateEr7Pro>(target, warm, config, result)) {
+            ++converged;
+        }
+        warm = result.q;
+    }
+    double stream_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = reachable_count; i < targets.size(); ++i) {
+        solveIkFromSeed<XMateEr7Pro>(targets[i], home, config, result);
+    }
+    double bound_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "ik warm start: stream " << stream_s / stream_count * 1e6 << "us/target (" << converged << "/"
+              << stream_count << " converged), unreachable " << bound_s / unreachable_count * 1e6 << "us/target"
+              << std::endl;
+}
+
+// 安全限制每次调用的耗时：目标在工作空间内外来回跳动，约一半的调用有限制生效
+void benchSafety() {
+    const std::size_t n = 2000000;
+    constexpr std::array<Halfspace, 6> workspace = boxHalfspaces({0.25, -0.55, 0.05}, {0.95, 0.55, 1.0});
+    SafetyLimits limits;
+    limits.joint_lower = XMateEr7Pro::kJointLower;
+    limits.joint_upper = XMateEr7Pro::kJointUpper;
+    limits.max_joint_step = {2.5e-3, 2.5e-3, 2.5e-3, 2.5e-3, 3e-3, 3e-3, 3e-3};
+    SafetyCounters counters;
+    SafetyFilter<workspace.size()> filter(workspace, limits, counters);
+
+    static std::array<std::array<double, 16>, 1024> poses;
+    static std::array<std::array<double, 7>, 1024> joints;
+    for (std::size_t i = 0; i < poses.size(); ++i) {
+        double t = i * 1e-3;
+        std::array<double, 7> q;
+        for (std::size_t k = 0; k < 7; ++k) {
+            q[k] = 0.5 * std::sin(3.0 * t + k) + (i % 2 ? 0.0 : 2e-3 * (k + 1));
+        }
+        joints[i] = q;
+        forwardKinematics(q, poses[i]);
+        poses[i][3] += (i % 2) * 0.6;
+    }
+    filter.reset(poses[0]);
+    filter.reset(joints[0]);
+
+    double pose_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 16> pose = poses[i & (poses.size() - 1)];
+        filter.filter(pose);
+    });
+    double joint_ns = nsPerCall(n, [&](std::size_t i) {
+        std::array<double, 7> q = joints[i & (joints.size() - 1)];
+        filter.filter(q);
+    });
+    // 轴空间的模式同时由正运动学检查 tcp 工作空间，越出时二分，是最坏情况的耗时
+    const std::array<double, 16> tcp_frame = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0.1, 0, 0, 0, 1};
+    filter.reset(joints[0]);
+    double joint_tcp_ns = nsPerCall(n / 10, [&](std::size_t i) {
+        std::array<double, 7> q = joints[i & (joints.size() - 1)];
+        filter.filter(q, tcp_frame);
+    });
+    std::cout << "safety x " << n << ": pose " << pose_ns << "ns/call, joints " << joint_ns << "ns/call, joints with tcp "
+              << joint_tcp_ns << "ns/call" << std::endl;
+    counters.print("safety");
+}
+
+// 当前线程已用的 CPU 时间 (秒)
+double threadCpuSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// zmq 接收线程的两种写法：dontwait 忙轮询与 zmq_poll + eventfd 唤醒
+// 发送线程以 1kHz 经本机 tcp 发布带发送时间戳的消息，接收线程放入 SpscQueue（相当于交给实时回调的邮箱），
+// 统计发送到放入队列的延迟，以及接收线程的 CPU 占用（空闲时段与发送时段分开统计）
+void benchWire() {
+    using json = nlohmann::json;
+    const std::size_t n = 200000;
+    const std::size_t chunk_steps = 20;
+
+    std::array<double, 16> pose;
+    forwardKinematics(std::array<double, 7>{0.0, 0.5, 0.0, -1.2, 0.0, 0.8, 0.0}, pose);
+    std::vector<double> chunk_values(chunk_steps * 7);
+    for (std::size_t i = 0; i < chunk_values.size(); ++i) {
+        chunk_values[i] = 0.5 * std::sin(0.1 * i);
+    }
+
+    // 与发送端 Python 脚本相同的 JSON 消息
+    json pose_json;
+    pose_json["pose_matrix"] = pose;
+    pose_json["sent_time"] = 12345.678;
+    json chunk_json;
+    for (std::size_t s = 0; s < chunk_steps; ++s) {
+        chunk_json["joint_chunk"].push_back(std::vector<double>(chunk_values.begin() + s * 7, chunk_values.begin() + (s + 1) * 7));
+    }
+    chunk_json["chunk_start"] = 12345.7;
+    chunk_json["chunk_period"] = 0.01;
+    chunk_json["sent_time"] = 12345.678;
+    const std::string pose_text = pose_json.dump();
+    const std::string chunk_text = chunk_json.dump();
+
+    WireHeader pose_header;
+    pose_header.type = static_cast<uint8_t>(WireType::pose_matrix);
+    pose_header.flags = kWireSentTime;
+    pose_header.values_per_step = 16;
+    pose_header.sent_time = 12345.678;
+    WireHeader chunk_header;
+    chunk_header.type = static_cast<uint8_t>(WireType::joint_chunk);
+    chunk_header.flags = kWireSentTime;
+    chunk_header.steps = static_cast<uint32_t>(chunk_steps);
+    chunk_header.values_per_step = 7;
+    chunk_header.sent_time = 12345.678;
+    chunk_header.chunk_start = 12345.7;
+    chunk_header.chunk_period = 0.01;
+
+    std::array<double, 16> matrix;
+    std::array<std::array<double, 7>, 64> steps;
+    double checksum = 0.0;
+
+    // 与 zmq_receiver 相同：拷贝成 string，解析，再按键取出数组
+    auto json_pose = [&](std::size_t) {
+        std::string text(pose_text.data(), pose_text.size());
+        json msg = json::parse(text);
+        if (msg.contains("pose_matrix")) {
+            matrix = msg["pose_matrix"].get<std::array<double, 16>>();
+        }
+        checksum += matrix[3] + msg.value("sent_time", 0.0);
+    };
+    double json_pose_ns = nsPerCall(n, json_pose);
+    double json_pose_mallocs = mallocsPerCall(1000, json_pose);
+    double json_chunk_ns = nsPerCall(n / 4, [&](std::size_t) {
+        std::string text(chunk_text.data(), chunk_text.size());
+        json msg = json::parse(text);
+        const json& actions = msg["joint_chunk"];
+        for (std::size_t s = 0; s < actions.size(); ++s) {
+            steps[s] = actions[s].get<std::array<double, 7>>();
+        }
+        checksum += steps[chunk_steps - 1][6] + msg.value("chunk_period", 0.0);
+    });
+    std::cout << "wire json: pose_matrix " << pose_text.size() << "B " << json_pose_ns << "ns/msg " << json_pose_mallocs
+              << " mallocs/msg, joint_chunk x" << chunk_steps << " " << chunk_text.size() << "B " << json_chunk_ns
+              << "ns/msg" << std::endl;
+
+    // 只含常见键的消息由 JsonCommandScanner 在消息内存上直接解码，其余的回退到完整解析
+    JsonCommandScanner scanner;
+    JsonCommand decoded;
+    auto scan_pose = [&](std::size_t) {
+        if (scanner.scan(pose_text.data(), pose_text.size(), decoded) == JsonScanStatus::ok &&
+            decoded.has(JsonCommand::kPoseMatrix)) {
+            matrix = decoded.pose_matrix;
+        }
+        checksum += matrix[3] + decoded.sent_time;
+    };
+    double scan_pose_ns = nsPerCall(n, scan_pose);
+    double scan_pose_mallocs = mallocsPerCall(1000, scan_pose);
+    const std::string malformed_text = "{\"pose_matrix\": [1, 0, 0, 0.5, 0, 1, nan]}";
+    std::size_t rejected = 0;
+    double scan_reject_ns = nsPerCall(n, [&](std::size_t) {
+        rejected += scanner.scan(malformed_text.data(), malformed_text.size(), decoded) == JsonScanStatus::malformed;
+    });
+    double scan_fallback_ns = nsPerCall(n, [&](std::size_t) {
+        checksum += scanner.scan(chunk_text.data(), chunk_text.size(), decoded) == JsonScanStatus::fallback;
+    });
+    std::cout << "wire json scan: pose_matrix " << scan_pose_ns << "ns/msg " << scan_pose_mallocs
+              << " mallocs/msg, reject malformed " << scan_reject_ns << "ns/msg (" << rejected << "/" << n
+              << "), detect fallback " << scan_fallback_ns << "ns/msg" << std::endl;
+
+    for (bool f32 : {false, true}) {
+        std::vector<unsigned char> pose_bytes;
+        std::vector<unsigned char> chunk_bytes;
+        pose_header.flags = static_cast<uint8_t>(kWireSentTime | (f32 ? kWireFloat32 : 0));
+        chunk_header.flags = pose_header.flags;
+        encodeWire(pose_header, pose.data(), pose_bytes);
+        encodeWire(chunk_header, chunk_values.data(), chunk_bytes);
+        WireView wire;
+        double wire_pose_ns = nsPerCall(n, [&](std::size_t) {
+            if (wire.parse(pose_bytes.data(), pose_bytes.size()) == WireStatus::ok) {
+                wire.step(0, matrix);
+            }
+            checksum += matrix[3] + wire.header().sent_time;
+        });
+        double wire_chunk_ns = nsPerCall(n, [&](std::size_t) {
+            if (wire.parse(chunk_bytes.data(), chunk_bytes.size()) == WireStatus::ok) {
+                for (std::size_t s = 0; s < wire.steps(); ++s) {
+                    wire.step(s, steps[s]);
+                }
+            }
+            checksum += steps[chunk_steps - 1][6] + wire.header().chunk_period;
+        });
+        std::cout << "wire " << (f32 ? "f32" : "f64") << ": pose_matrix " << pose_bytes.size() << "B " << wire_pose_ns
+                  << "ns/msg, joint_chunk x" << chunk_steps << " " << chunk_bytes.size() << "B " << wire_chunk_ns
+                  << "ns/msg" << std::endl;
+    }
+    std::cout << "  (checksum " << checksum << ")" << std::endl;
+}
+
+// 与 zmq_sender 结构相同的状态消息，每次都附带 11 个延迟直方图
+template <class Json>
+void statusMessage(Json& msg, uint64_t seq, const std::array<double, 6>& tcp, const std::array<double, 7>& joints) {
+    msg["Seq"] = seq;
+    msg["Timestamp"] = seq * 2e-2;
+    msg["ActualTCPPose"] = {tcp[0], tcp[1], tcp[2], tcp[3], tcp[4], tcp[5]};
+    msg["ActualJointPose"] = {joints[0], joints[1], joints[2], joints[3], joints[4], joints[5], joints[6]};
+    msg["ActualGripperPose"] = 0.04;
+    msg["Mode"] = "joint_pose";
+    Json& latency = msg["Latency"];
+    for (const char* name : {"period", "state_read", "command_read", "compute", "callback", "command_age", "jacobian",
+                             "safety", "playout_slack", "playout_late", "mode_switch"}) {
+        Json& hist = latency[name];
+        hist["n"] = seq;
+        hist["p50"] = 12.5;
+        hist["p99"] = 40.25;
+        hist["p99.9"] = 81.0;
+        hist["max"] = 120.0;
+    }
+}
+
+void benchJsonArena() {
+    using json = nlohmann::json;
+    const std::size_t n = 20000;
+    const std::array<double, 6> tcp = {0.63, 0.0, 0.51, 3.1416, 0.0, 1.5708};
+    const std::array<double, 7> joints = {0.0, 0.5, 0.0, -1.2, 0.0, 0.8, 0.0};
+    std::size_t bytes = 0;
+
+    // 发送端：原来每条消息新建 json 并 dump 成新的字符串
+    auto sender_heap = [&](std::size_t i) {
+        json msg;
+        statusMessage(msg, i, tcp, joints);
+        std::string text = msg.dump();
+        bytes += text.size();
+    };
+    // 现在 json 在 arena 上构造且不析构，序列化到复用的字符串
+    JsonArena sender_arena(1 << 16);
+    std::string sender_text;
+    sender_text.reserve(8192);
+    auto sender_arena_json = [&](std::size_t i) {
+        JsonArenaScope scope(sender_arena);
+        arena_json& msg = sender_arena.make<arena_json>();
+        statusMessage(msg, i, tcp, joints);
+        dumpJson(msg, sender_text);
+        bytes += sender_text.size();
+    };
+    sender_arena_json(0);
+    double heap_ns = nsPerCall(n, sender_heap);
+    double heap_mallocs = mallocsPerCall(1000, sender_heap);
+    double arena_ns = nsPerCall(n, sender_arena_json);
+    double arena_mallocs = mallocsPerCall(1000, sender_arena_json);
+    std::cout << "json sender " << sender_text.size() << "B: heap " << heap_ns << "ns/msg " << heap_mallocs
+              << " mallocs/msg, arena " << arena_ns << "ns/msg " << arena_mallocs << " mallocs/msg (peak "
+              << sender_arena.peak() << "B, overflows " << sender_arena.overflows() << ")" << std::endl;
+
+    // 接收端：JsonCommandScanner 不认识的消息（模式切换、动作块）才构造完整的 json
+    json chunk_json;
+    for (std::size_t s = 0; s < 20; ++s) {
+        chunk_json["joint_chunk"].push_back(joints);
+    }
+    chunk_json["chunk_period"] = 0.01;
+    const std::string mode_text = "{\"mode\": \"joint_pose\", \"position_control\": true}";
+    const std::string chunk_text = chunk_json.dump();
+    JsonArena receiver_arena(1 << 16);
+    for (const std::string* text : {&mode_text, &chunk_text}) {
+        auto receiver_heap = [&](std::size_t) {
+            json msg = json::parse(text->data(), text->data() + text->size(), nullptr, false);
+            bytes += msg.size();
+        };
+        auto receiver_arena_json = [&](std::size_t) {
+            JsonArenaScope scope(receiver_arena);
+            arena_json& msg = receiver_arena.make<arena_json>(
+                arena_json::parse(text->data(), text->data() + text->size(), nullptr, false));
+            bytes += msg.size();
+        };
+        double heap_ns = nsPerCall(n, receiver_heap);
+        double heap_mallocs = mallocsPerCall(1000, receiver_heap);
+        double arena_ns = nsPerCall(n, receiver_arena_json);
+        double arena_mallocs = mallocsPerCall(1000, receiver_arena_json);
+        std::cout << "json receiver " << (text == &mode_text ? "mode" : "joint_chunk x20") << " " << text->size()
+                  << "B: heap " << heap_ns << "ns/msg " << heap_mallocs << " mallocs/msg, arena " << arena_ns
+                  << "ns/msg " << arena_mallocs << " mallocs/msg" << std::endl;
+    }
+    std::cout << "  (bytes " << bytes << ")" << std::endl;
+}
+
+void benchReceiver() {
+    const std::size_t messages = 2000;
+    const std::chrono::microseconds interval(1000);
+    const std::chrono::milliseconds idle(500);
+
+    for (bool use_poll : {false, true}) {
+        zmq::context_t context(1);
+        zmq::socket_t publisher(context, ZMQ_PUB);
+        publisher.bind("tcp://127.0.0.1:5599");
+        zmq::socket_t subscriber(context, ZMQ_SUB);
+        subscriber.connect("tcp://127.0.0.1:5599");
+        subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+        // 等订阅建立，避免丢掉最开始的消息
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        SpscQueue<int64_t, 4096> mailbox;
+        LatencyHistogram latency;
+        std::atomic<bool> running{true};
+        std::atomic<bool> sending{false};
+        WakeupFd wakeup;
+        double idle_cpu = 0.0;
+        double active_cpu = 0.0;
+        std::size_t received_count = 0;
+
+        std::thread receiver([&]() {
+            auto handle = [&](zmq::message_t& message) {
+                int64_t sent_ns;
+                std::memcpy(&sent_ns, message.data(), sizeof(sent_ns));
+                mailbox.push(sent_ns);
+                int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                latency.record(static_cast<uint64_t>(now_ns - sent_ns));
+                while (mailbox.peek()) {
+                    mailbox.discard();
+                }
+                ++received_count;
+            };
+            double start_cpu = threadCpuSeconds();
+            bool was_sending = false;
+            zmq::pollitem_t items[] = {{subscriber.handle(), 0, ZMQ_POLLIN, 0}, {nullptr, wakeup.fd(), ZMQ_POLLIN, 0}};
+            while (running) {
+                if (!was_sending && sending) {
+                    was_sending = true;
+                    idle_cpu = threadCpuSeconds() - start_cpu;
+                    start_cpu = threadCpuSeconds();
+                }
+                if (use_poll) {
+                    zmq::poll(items, 2, std::chrono::milliseconds(-1));
+                    if (items[1].revents & ZMQ_POLLIN) {
+                        wakeup.drain();
+                    }
+                }
+                while (true) {
+                    zmq::message_t message;
+                    if (!subscriber.recv(message, zmq::recv_flags::dontwait)) {
+                        break;
+                    }
+                    handle(message);
+                }
+            }
+            active_cpu = threadCpuSeconds() - start_cpu;
+        });
+
+        // 先空闲一段时间，再以固定间隔发送
+        std::this_thread::sleep_for(idle);
+        sending = true;
+        wakeup.notify();
+        auto send_start = std::chrono::steady_clock::now();
+        auto next = send_start;
+        for (std::size_t i = 0; i < messages; ++i) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+            int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            zmq::message_t message(sizeof(now_ns));
+            std::memcpy(message.data(), &now_ns, sizeof(now_ns));
+            publisher.send(message, zmq::send_flags::none);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        double active_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - send_start).count();
+        running = false;
+        wakeup.notify();
+        receiver.join();
+
+        std::cout << "receiver " << (use_poll ? "zmq_poll+eventfd" : "dontwait spin") << ": received " << received_count
+                  << "/" << messages << ", idle cpu " << idle_cpu / std::chrono::duration<double>(idle).count() * 100.0
+                  << "%, active cpu " << active_cpu / active_seconds * 100.0 << "%" << std::endl;
+        latency.print("  send to mailbox");
+    }
+}
+
+
+int main(int argc, char** argv) {
+    std::cout.precision(4);
+    auto selected = [&](const char* name) {
+        if (argc < 2) {
+            return true;
+        }
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (selected("rotation")) {
+        benchRotation();
+    }
+    if (selected("fk")) {
+        benchFk();
+    }
+    if (selected("ik")) {
+        benchIk();
+    }
+    if (selected("safety")) {
+        benchSafety();
+    }
+    if (selected("wire")) {
+        benchWire();
+    }
+    if (selected("arena")) {
+        benchJsonArena();
+    }
+    if (selected("receiver")) {
+        benchReceiver();
+    }
+    return 0;
+}
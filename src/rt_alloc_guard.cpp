@@ -0,0 +1,95 @@
+#include "rt_alloc_guard.h"
+
+#ifdef RT_ALLOC_GUARD
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <iostream>
+
+// 替换 glibc 的 malloc 系列函数，实际分配仍交给 __libc_* 实现
+// operator new/delete 最终也会调用这里，因此 C++ 的分配同样被统计
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace {
+
+thread_local bool armed = false;
+std::atomic<uint64_t> malloc_count{0};
+std::atomic<uint64_t> free_count{0};
+
+inline void countMalloc() {
+    if (armed) {
+        malloc_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void countFree(void* ptr) {
+    if (armed && ptr) {
+        free_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(std::size_t size) {
+    countMalloc();
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) {
+    countMalloc();
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, std::size_t size) {
+    countMalloc();
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+    countMalloc();
+    return __libc_memalign(alignment, size);
+}
+
+// 与 glibc 一致：对齐必须是 sizeof(void*) 的 2 的幂倍，失败时返回错误码而不设置 errno
+int posix_memalign(void** memptr, std::size_t alignment, std::size_t size) {
+    if (alignment == 0 || alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    countMalloc();
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void* ptr) {
+    countFree(ptr);
+    __libc_free(ptr);
+}
+
+}
+
+void rtAllocGuardArm() { armed = true; }
+
+void rtAllocGuardDisarm() { armed = false; }
+
+uint64_t rtAllocGuardMallocs() { return malloc_count.load(std::memory_order_relaxed); }
+
+uint64_t rtAllocGuardFrees() { return free_count.load(std::memory_order_relaxed); }
+
+void rtAllocGuardPrint(const char* name) {
+    std::cout << name << ": malloc=" << rtAllocGuardMallocs() << " free=" << rtAllocGuardFrees() << std::endl;
+}
+
+#endif